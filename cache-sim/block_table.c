@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "block_table.h"
+
+#define INITIAL_SLOTS 1024
+
+block_table_t *make_block_table(size_t entry_size) {
+    block_table_t *table = malloc(sizeof(block_table_t));
+
+    table->entry_size = entry_size;
+    table->n_slot = INITIAL_SLOTS;
+    table->n_used = 0;
+    table->entries = calloc(table->n_slot, entry_size);
+    table->keys = calloc(table->n_slot, sizeof(unsigned long));
+    table->used = calloc(table->n_slot, sizeof(bool));
+
+    return table;
+}
+
+void free_block_table(block_table_t *table) {
+    free(table->entries);
+    free(table->keys);
+    free(table->used);
+    free(table);
+}
+
+static unsigned long hash_block(unsigned long block_addr) {
+    return (block_addr * 0x9E3779B97F4A7C15UL) >> 16;
+}
+
+/* The slot holding block_addr, or the empty slot it would go in. */
+static long probe(const unsigned long *keys, const bool *used, long n_slot, unsigned long block_addr) {
+    long slot = hash_block(block_addr) & (n_slot - 1);
+    while (used[slot] && keys[slot] != block_addr) {
+        slot = (slot + 1) & (n_slot - 1);
+    }
+    return slot;
+}
+
+static void grow(block_table_t *table) {
+    long n_slot = table->n_slot * 2;
+    char *entries = calloc(n_slot, table->entry_size);
+    unsigned long *keys = calloc(n_slot, sizeof(unsigned long));
+    bool *used = calloc(n_slot, sizeof(bool));
+
+    for (long i = 0; i < table->n_slot; i++) {
+        if (table->used[i]) {
+            long slot = probe(keys, used, n_slot, table->keys[i]);
+            memcpy(entries + slot * table->entry_size, table->entries + i * table->entry_size, table->entry_size);
+            keys[slot] = table->keys[i];
+            used[slot] = true;
+        }
+    }
+
+    free(table->entries);
+    free(table->keys);
+    free(table->used);
+    table->entries = entries;
+    table->keys = keys;
+    table->used = used;
+    table->n_slot = n_slot;
+}
+
+void *block_table_find(block_table_t *table, unsigned long block_addr) {
+    long slot = probe(table->keys, table->used, table->n_slot, block_addr);
+    return table->used[slot] ? table->entries + slot * table->entry_size : NULL;
+}
+
+void *block_table_get(block_table_t *table, unsigned long block_addr, bool *added_f) {
+    long slot = probe(table->keys, table->used, table->n_slot, block_addr);
+    if (added_f)
+        *added_f = !table->used[slot];
+    if (table->used[slot])
+        return table->entries + slot * table->entry_size;
+
+    // doubles the table once it is half full
+    if (2 * (table->n_used + 1) > table->n_slot) {
+        grow(table);
+        slot = probe(table->keys, table->used, table->n_slot, block_addr);
+    }
+    table->keys[slot] = block_addr;
+    table->used[slot] = true;
+    table->n_used++;
+    return table->entries + slot * table->entry_size;
+}
+
+void *block_table_slot(block_table_t *table, long slot) {
+    return table->used[slot] ? table->entries + slot * table->entry_size : NULL;
+}
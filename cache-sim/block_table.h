@@ -0,0 +1,39 @@
+#ifndef __BLOCK_TABLE_H
+#define __BLOCK_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Open addressing hash table from block address to a fixed size entry,
+ * for per block bookkeeping such as the sharing tracker and the socket
+ * directory. New entries start zeroed. The table doubles once it is half
+ * full, which moves the entries, so an entry pointer is only valid until
+ * the next block is added.
+ */
+typedef struct {
+  size_t entry_size;
+  char *entries;         // [slot * entry_size]
+  unsigned long *keys;   // [slot], block address of the entry
+  bool *used;            // [slot], whether the slot holds an entry
+  long n_slot;           // power of 2
+  long n_used;
+} block_table_t;
+
+block_table_t *make_block_table(size_t entry_size);
+void free_block_table(block_table_t *table);
+
+/* The entry of block_addr, or NULL if it has none. */
+void *block_table_find(block_table_t *table, unsigned long block_addr);
+
+/* The entry of block_addr, added zeroed if it has none yet. added_f, if
+ * not NULL, is set when it was added.
+ */
+void *block_table_get(block_table_t *table, unsigned long block_addr, bool *added_f);
+
+/* The entry in slot, or NULL if the slot is empty. Iterating slot from 0
+ * to n_slot visits every entry.
+ */
+void *block_table_slot(block_table_t *table, long slot);
+
+#endif  // BLOCK_TABLE
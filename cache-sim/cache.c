@@ -6,6 +6,57 @@
 #include "cache.h"
 #include "print_helpers.h"
 
+// how many accesses access_cache_batch looks ahead when prefetching sets
+#define PREFETCH_BATCH 16
+
+#ifdef __GNUC__
+#define PREFETCH(addr) __builtin_prefetch(addr, 1)
+#define ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define PREFETCH(addr)
+#define ALWAYS_INLINE
+#endif
+
+#if defined(__clang__)
+#define UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define UNROLL _Pragma("GCC unroll 16")
+#else
+#define UNROLL
+#endif
+
+static access_fn_t select_access_kernel(cache_t *cache);
+
+static bool is_power_of_2(int x) {
+    return x > 0 && (x & (x - 1)) == 0;
+}
+
+/* Xors together every n_bit wide slice of the block number, so that
+ * addresses that only differ above the index bits still spread out.
+ */
+static inline unsigned long xor_fold(unsigned long block, int n_bit) {
+    if (n_bit == 0)
+        return 0;
+
+    unsigned long folded = 0;
+    unsigned long mask = (1UL << n_bit) - 1;
+    while (block) {
+        folded ^= block & mask;
+        block >>= n_bit;
+    }
+    return folded;
+}
+
+/* The set a block maps to in a given way of a skewed cache. Each way
+ * multiplies by a different odd constant, so blocks that conflict in one
+ * way are unlikely to conflict in the others.
+ */
+static inline unsigned long skew_index(cache_t *cache, unsigned long block, int way) {
+    unsigned long h = (block ^ (block >> cache->n_index_bit)) *
+                      (0x9E3779B97F4A7C15UL + 2 * way * 0xBF58476D1CE4E5B9UL);
+    return (h >> 32) % cache->n_set;
+}
+
 cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t protocol, bool lru_on_invalidate_f) {
     cache_t *cache = malloc(sizeof(cache_t));
     cache->stats = make_cache_stats();
@@ -16,19 +67,45 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
     cache->n_cache_line = capacity / block_size;
     cache->n_set = capacity / (assoc * block_size);
     cache->n_offset_bit = log2(block_size);
-    cache->n_index_bit = log2(capacity) - log2(assoc) - log2(block_size);
+    cache->n_index_bit = ceil(log2(cache->n_set));
     cache->n_tag_bit = ADDRESS_SIZE - cache->n_offset_bit - cache->n_index_bit;
 
+    // bit slicing only works for a power of 2 number of sets, otherwise
+    // the index is a modulo and the tag has to be the whole block number
+    cache->index_fn = INDEX_MOD;
+    cache->n_index_set = cache->n_set;
+    cache->tag_shift = cache->n_offset_bit + cache->n_index_bit;
+    if (!is_power_of_2(cache->n_set)) {
+        cache->tag_shift = cache->n_offset_bit;
+        cache->n_tag_bit = ADDRESS_SIZE - cache->n_offset_bit;
+    }
+
     // next create the cache lines and the array of LRU bits
     // - malloc an array with n_rows
-    // - for each element in the array, malloc another array with n_col
+    // - point each row into one contiguous block of n_rows * n_col lines,
+    //   so the set for an index can be found (and prefetched) without
+    //   first loading the row pointer
 
     cache->lines = malloc(cache->n_set * sizeof(cache_line_t *));
+    cache_line_t *all_lines = malloc(cache->n_cache_line * sizeof(cache_line_t));
     for (int i = 0; i < cache->n_set; i++) {
-        cache->lines[i] = malloc(cache->assoc * sizeof(cache_line_t));
+        cache->lines[i] = &all_lines[i * cache->assoc];
     }
 
     cache->lru_way = malloc(cache->n_set * sizeof(int));
+    cache->tag_index = NULL;
+    cache->last_use = NULL;
+    cache->use_clock = 0;
+    cache->victim = NULL;
+    cache->n_victim = 0;
+    cache->victim_clock = 0;
+
+    cache->write_through_f = false;
+    cache->write_allocate_f = true;
+    cache->wc = NULL;
+    cache->n_wc = 0;
+    cache->wc_granule = WORD_SIZE;
+    cache->wc_clock = 0;
 
     // initializes cache tags to 0, dirty bits to false,
     // state to INVALID, and LRU bits to 0
@@ -44,9 +121,104 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
     cache->protocol = protocol;
     cache->lru_on_invalidate_f = lru_on_invalidate_f;
 
+    cache->last_set = 0;
+    cache->last_way = 0;
+
+    cache->access = select_access_kernel(cache);
+
     return cache;
 }
 
+void free_cache(cache_t *cache) {
+    free(cache->lines[0]);
+    free(cache->lines);
+    free(cache->lru_way);
+    if (cache->tag_index) free_tag_index(cache->tag_index);
+    free(cache->last_use);
+    free(cache->victim);
+    free(cache->wc);
+    free(cache->stats);
+    free(cache);
+}
+
+/* Index the tags of every set so hits are found without scanning all the
+ * ways. Worth it for highly associative caches only, and must be called
+ * before the first access.
+ */
+void enable_tag_index(cache_t *cache) {
+    if (cache->index_fn == INDEX_SKEW)
+        return;  // no sets to index
+    cache->tag_index = make_tag_index(cache->n_set, cache->assoc, 0);
+    cache->access = select_access_kernel(cache);
+}
+
+/* Puts a fully associative buffer of n_victim lines behind the cache.
+ * Lines evicted from any set go there instead of being dropped, and a
+ * miss that finds its block there swaps it back in without a bus
+ * transaction. Must be called before the first access.
+ */
+void enable_victim_buffer(cache_t *cache, int n_victim) {
+    cache->n_victim = n_victim;
+    cache->victim = calloc(n_victim, sizeof(victim_line_t));  // all INVALID
+}
+
+/* Write-through caches never hold dirty lines, every store goes on the bus
+ * instead. Without write-allocate, a store miss leaves the cache alone.
+ */
+void set_write_policy(cache_t *cache, bool write_through_f, bool write_allocate_f) {
+    cache->write_through_f = write_through_f;
+    cache->write_allocate_f = write_allocate_f;
+}
+
+/* Puts an n_wc entry write-combining buffer in front of the bus, so
+ * stores written through to the same block merge into one transfer.
+ */
+void enable_write_combining(cache_t *cache, int n_wc) {
+    cache->n_wc = n_wc;
+    cache->wc = calloc(n_wc, sizeof(wc_entry_t));  // all empty
+
+    // the masks are 64 bits wide, so large blocks get coarser granules
+    if (cache->block_size / cache->wc_granule > 64)
+        cache->wc_granule = cache->block_size / 64;
+}
+
+static int largest_prime_at_most(int n) {
+    for (; n > 2; n--) {
+        bool prime_f = true;
+        for (int d = 2; d * d <= n && prime_f; d++) {
+            if (n % d == 0)
+                prime_f = false;
+        }
+        if (prime_f)
+            return n;
+    }
+    return n;
+}
+
+/* Switches the cache from bit slicing (or modulo) to another index
+ * function. Every function other than INDEX_MOD spreads the whole block
+ * number over the sets, so the tag becomes the whole block number too.
+ * Must be called before the first access.
+ */
+void set_cache_index_fn(cache_t *cache, enum index_fn_t index_fn) {
+    cache->index_fn = index_fn;
+    if (index_fn == INDEX_MOD)
+        return;
+
+    cache->tag_shift = cache->n_offset_bit;
+    cache->n_tag_bit = ADDRESS_SIZE - cache->n_offset_bit;
+
+    if (index_fn == INDEX_PRIME) {
+        cache->n_index_set = largest_prime_at_most(cache->n_set);
+    }
+
+    if (index_fn == INDEX_SKEW) {
+        cache->last_use = calloc(cache->n_cache_line, sizeof(unsigned long));
+    }
+
+    cache->access = select_access_kernel(cache);
+}
+
 /* Given a configured cache, returns the tag portion of the given address.
  *
  * Example: a cache with 4 bits each in tag, index, offset
@@ -54,7 +226,7 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
  * in decimal -- get_cache_tag(3921) returns 15
  */
 unsigned long get_cache_tag(cache_t *cache, unsigned long addr) {
-    return addr >> (cache->n_offset_bit + cache->n_index_bit);
+    return addr >> cache->tag_shift;
 }
 
 /* Given a configured cache, returns the index portion of the given address.
@@ -65,6 +237,20 @@ unsigned long get_cache_tag(cache_t *cache, unsigned long addr) {
  */
 unsigned long get_cache_index(cache_t *cache, unsigned long addr) {
     unsigned long index_bits = addr >> cache->n_offset_bit;
+
+    switch (cache->index_fn) {
+    case INDEX_MOD:
+        if (cache->tag_shift == cache->n_offset_bit) // not a power of 2
+            return index_bits % cache->n_set;
+        break;
+    case INDEX_XOR:
+        return xor_fold(index_bits, cache->n_index_bit) % cache->n_set;
+    case INDEX_PRIME:
+        return index_bits % cache->n_index_set;
+    case INDEX_SKEW:
+        return skew_index(cache, index_bits, 0);
+    }
+
     unsigned long index_mask = (1 << cache->n_index_bit) - 1;
     return index_bits & index_mask;
 }
@@ -80,132 +266,485 @@ unsigned long get_cache_block_addr(cache_t *cache, unsigned long addr) {
     return addr & block_mask;
 }
 
-bool access_cache_msi(cache_t *cache, int tag, int index, enum action_t action) {
+// the outcome of looking at one way holding the tag
+#define KEEP_LOOKING -1
+
+/* MSI: the first line holding the tag decides the access, whatever its state. */
+static inline int visit_line_msi(cache_t *cache, cache_line_t *line, enum action_t action) {
+    // only stores that leave the line MODIFIED dirty it, not those written around it
+    bool dirty_f = action == STORE && !cache->write_through_f;
+
+    switch (line->state) {
+    case MODIFIED:
+        update_stats(cache->stats, true, line->dirty_f && (action == LD_MISS || action == ST_MISS), false, action);
+        line->dirty_f |= dirty_f;
+        if (action == LD_MISS) {
+            line->state = SHARED;
+        } else if (action == ST_MISS) {
+            line->state = INVALID;
+        }
+        return HIT;
+    case SHARED:
+        update_stats(cache->stats, true, false, action == STORE, action); // upgrade miss
+        if (action == STORE) {                                            // store hit
+            line->state = MODIFIED;
+            line->dirty_f |= dirty_f;
+        } else if (action == ST_MISS) {
+            line->state = INVALID;
+        }
+        return HIT;
+    case INVALID:
+        update_stats(cache->stats, false, false, false, action);
+        if (action == LOAD) { // load hit
+            line->state = SHARED;
+            cache->stats->n_fills++;
+        } else if (action == STORE && cache->write_allocate_f) { // store hit
+            line->state = MODIFIED;
+            line->dirty_f |= dirty_f;
+            cache->stats->n_fills++;
+        } else if (action == STORE && !cache->write_through_f) {
+            cache->stats->B_write_around += WORD_SIZE;
+        }
+        return MISS;
+    case VALID:
+        break;
+    }
+    return KEEP_LOOKING;
+}
 
-    for (int i = 0; i < cache->assoc; i++) {     // search cache
-        if (cache->lines[index][i].tag == tag) { // exists in cache
-            log_way(i);
+/* NONE and VI: only a VALID line holding the tag is a hit. */
+static inline int visit_line_vi(cache_t *cache, cache_line_t *line, enum action_t action,
+                                const enum protocol_t protocol) {
+    if (line->state == VALID) {
+        // ignore snoops
+        if (action == LOAD || action == STORE) {
+            update_stats(cache->stats, true, false, false, action);
 
-            if (action == LOAD || action == STORE) { // ignore snoops
-                cache->lru_way[index] = (i + 1) % cache->assoc;
-                if (action == STORE && !cache->lines[index][i].dirty_f) {
-                    cache->lines[index][i].dirty_f = true;
-                }
+            if (action == STORE && !line->dirty_f && !cache->write_through_f) {
+                line->dirty_f = true;
             }
+        }
 
-            switch (cache->lines[index][i].state) {
-            case MODIFIED:
-                update_stats(cache->stats, true, cache->lines[index][i].dirty_f && (action == LD_MISS || action == ST_MISS), false, action);
-                if (action == LD_MISS) {
-                    cache->lines[index][i].state = SHARED;
-                } else if (action == ST_MISS) {
-                    cache->lines[index][i].state = INVALID;
-                }
-                return true;
-            case SHARED:
-                update_stats(cache->stats, true, false, action == STORE, action); // upgrade miss
-                if (action == STORE) {                                            // store hit
-                    cache->lines[index][i].state = MODIFIED;
-                } else if (action == ST_MISS) {
-                    cache->lines[index][i].state = INVALID;
-                }
-                return true;
-            case INVALID:
-                update_stats(cache->stats, false, false, false, action);
-                if (action == LOAD) { // load hit
-                    cache->lines[index][i].state = SHARED;
-                } else if (action == STORE) { // store hit
-                    cache->lines[index][i].state = MODIFIED;
-                }
-                return false;
-            case VALID:
-                break;
+        // snoops
+        if (protocol == VI && (action == LD_MISS || action == ST_MISS)) {
+            line->state = INVALID;
+            if (line->dirty_f) { // writeback
+                line->dirty_f = false;
+                update_stats(cache->stats, false, true, false, action);
             }
         }
+
+        return HIT;
+    } else {
+        if (protocol == VI && (action == LOAD || (action == STORE && cache->write_allocate_f))) {
+            line->state = VALID;
+        }
     }
+    return KEEP_LOOKING;
+}
 
-    // cache miss
+static inline int visit_line(cache_t *cache, cache_line_t *line, enum action_t action,
+                             const enum protocol_t protocol) {
+    if (protocol == MSI)
+        return visit_line_msi(cache, line, action);
+    return visit_line_vi(cache, line, action, protocol);
+}
+
+/* Processes the access on a way holding the tag. A way the protocol
+ * considers (MSI: any state, otherwise VALID only) also becomes the last
+ * way touched and moves the LRU way past it.
+ */
+static inline int visit_way(cache_t *cache, unsigned long index, int i, enum action_t action,
+                            const int assoc, const enum protocol_t protocol) {
+    cache_line_t *line = &cache->lines[index][i];
+
+    if (protocol == MSI || line->state == VALID) {
+        log_way(cache, i);
+        if (action == LOAD || action == STORE) { // ignore snoops
+            cache->lru_way[index] = (i + 1) % assoc;
+        }
+    }
+
+    return visit_line(cache, line, action, protocol);
+}
+
+static inline void set_tag(cache_t *cache, unsigned long index, int way, unsigned long tag) {
+    if (cache->tag_index)
+        tag_index_move(cache->tag_index, index, way, cache->lines[index][way].tag, tag);
+    cache->lines[index][way].tag = tag;
+}
+
+/* The victim buffer holds lines from every set, so it keys them by
+ * their whole block number rather than their tag.
+ */
+static inline unsigned long line_block(cache_t *cache, unsigned long tag, unsigned long index) {
+    if (cache->tag_shift == cache->n_offset_bit) // tag is already the block number
+        return tag;
+    return (tag << cache->n_index_bit) | index;
+}
+
+static victim_line_t *find_victim(cache_t *cache, unsigned long block) {
+    for (int i = 0; i < cache->n_victim; i++) {
+        if (cache->victim[i].line.state != INVALID && cache->victim[i].line.tag == block)
+            return &cache->victim[i];
+    }
+    return NULL;
+}
+
+/* Moves a valid line evicted from the given set into the victim buffer,
+ * in place of an invalid entry if there is one, else the least recently
+ * used. Returns true if the entry pushed out has to be written back.
+ */
+static bool evict_to_victim(cache_t *cache, cache_line_t *line, unsigned long index) {
+    victim_line_t *entry = &cache->victim[0];
+    for (int i = 0; i < cache->n_victim; i++) {
+        if (cache->victim[i].line.state == INVALID) {
+            entry = &cache->victim[i];
+            break;
+        }
+        if (cache->victim[i].last_use < entry->last_use)
+            entry = &cache->victim[i];
+    }
+
+    bool writeback_f = entry->line.state != INVALID && entry->line.dirty_f;
+
+    entry->line = *line;
+    entry->line.tag = line_block(cache, line->tag, index);
+    entry->last_use = ++cache->victim_clock;
+
+    return writeback_f;
+}
+
+/* On a miss, looks for the block in the victim buffer. If it is there it
+ * swaps places with the line in the given way, and the access is then
+ * processed on that way like any other hit, without going on the bus.
+ */
+static bool victim_hit(cache_t *cache, unsigned long tag, unsigned long index, int way, enum action_t action,
+                       const int assoc, const enum protocol_t protocol) {
+    victim_line_t *entry = find_victim(cache, line_block(cache, tag, index));
+    if (entry == NULL)
+        return false;
+
+    cache_line_t *line = &cache->lines[index][way];
+    cache_line_t swapped = *line;
+
+    cache->stats->n_victim_hits++;
+    if (entry->line.dirty_f)
+        cache->stats->n_victim_dirty_hits++; // its writeback never happens
+
+    set_tag(cache, index, way, tag);
+    line->dirty_f = entry->line.dirty_f;
+    line->state = entry->line.state;
+
+    if (swapped.state != INVALID) {
+        entry->line = swapped;
+        entry->line.tag = line_block(cache, swapped.tag, index);
+        entry->last_use = ++cache->victim_clock;
+    } else {
+        entry->line.state = INVALID;
+        entry->line.dirty_f = false;
+    }
+
+    return visit_way(cache, index, way, action, assoc, protocol) == HIT;
+}
+
+/* Snoops the victim buffer after the sets missed, returns true on a hit. */
+static bool snoop_victim(cache_t *cache, unsigned long tag, unsigned long index, enum action_t action,
+                         const enum protocol_t protocol) {
+    victim_line_t *entry = find_victim(cache, line_block(cache, tag, index));
+    if (entry == NULL)
+        return false;
+    return visit_line(cache, &entry->line, action, protocol) == HIT;
+}
+
+/* A store miss without write-allocate leaves the cache alone. Under
+ * write-back its word goes straight to memory, under write-through it
+ * was already written through like every other store.
+ */
+static inline bool write_around(cache_t *cache, enum action_t action) {
+    if (action != STORE || cache->write_allocate_f)
+        return false;
+
+    update_stats(cache->stats, false, false, false, action);
+    if (!cache->write_through_f)
+        cache->stats->B_write_around += WORD_SIZE;
+    return true;
+}
+
+/* Replaces the line in the given way with the block missed on. */
+static inline void fill_way(cache_t *cache, unsigned long tag, unsigned long index, int way, enum action_t action,
+                            const enum protocol_t protocol) {
+    cache_line_t *line = &cache->lines[index][way];
+    log_way(cache, way);
+
+    // writeback if line is dirty, or with a victim buffer, if moving the
+    // line there pushes out a dirty one
+    bool writeback_f = line->dirty_f;
+    if (cache->victim && line->state != INVALID)
+        writeback_f = evict_to_victim(cache, line, index);
+    update_stats(cache->stats, false, writeback_f, false, action);
+
+    set_tag(cache, index, way, tag);
+    cache->stats->n_fills++;
+    line->dirty_f = action == STORE && !cache->write_through_f;
+    if (protocol == MSI)
+        line->state = (action == STORE) ? MODIFIED : SHARED;
+    else
+        line->state = VALID;
+}
+
+static inline bool miss(cache_t *cache, unsigned long tag, unsigned long index, enum action_t action,
+                        const int assoc, const enum protocol_t protocol) {
     if (action == LD_MISS || action == ST_MISS) { // ignore snoops
+        if (cache->victim && snoop_victim(cache, tag, index, action, protocol))
+            return true;
         update_stats(cache->stats, false, false, false, action);
         return false;
     }
+
     int lru_way = cache->lru_way[index];
-    update_stats(cache->stats, false, cache->lines[index][lru_way].dirty_f, false, action);
-    cache->lines[index][lru_way].tag = tag;
-    cache->lines[index][lru_way].dirty_f = action == STORE;
-    cache->lines[index][lru_way].state = (action == STORE) ? MODIFIED : ((action == LOAD) ? SHARED : INVALID);
-    cache->lru_way[index] = (lru_way + 1) % cache->assoc;
+    if (cache->victim && victim_hit(cache, tag, index, lru_way, action, assoc, protocol))
+        return true;
+    if (write_around(cache, action))
+        return false;
+
+    fill_way(cache, tag, index, lru_way, action, protocol);
+    cache->lru_way[index] = (lru_way + 1) % assoc;
 
     return false;
 }
 
-/* This method takes a cache, an address, and an action
- * it proceses the cache access. functionality in no particular order:
- *   - look up the address in the cache, determine if hit or miss
- *   - update the LRU_way, cacheTags, state, dirty flags if necessary
- *   - update the cache statistics (call update_stats)
- * return true if there was a hit, false if there was a miss
- * Use the "get" helper functions above. They make your life easier.
+/* The whole access, written once for every cache shape. The kernels below
+ * call it with a constant assoc and protocol, so that each gets its own copy
+ * with the way loop unrolled and the protocol checks folded away; the
+ * generic path calls it with the cache's own values.
  */
-bool access_cache(cache_t *cache, unsigned long addr, enum action_t action) {
+static inline ALWAYS_INLINE bool access_set(cache_t *cache, unsigned long tag, unsigned long index,
+                                            enum action_t action, const int assoc,
+                                            const enum protocol_t protocol, const bool indexed) {
+    log_set(cache, index);
+
+    if (indexed) {
+        tag_index_t *tag_index = cache->tag_index;
+        for (int i = tag_index_first(tag_index, index, tag); i != NO_WAY; i = tag_index_next(tag_index, index, i)) {
+            if (cache->lines[index][i].tag == tag) {
+                int result = visit_way(cache, index, i, action, assoc, protocol);
+                if (result != KEEP_LOOKING)
+                    return result;
+            }
+        }
+    } else {
+        cache_line_t *set = cache->lines[index];
+        UNROLL
+        for (int i = 0; i < assoc; i++) {
+            if (set[i].tag == tag) {
+                int result = visit_way(cache, index, i, action, assoc, protocol);
+                if (result != KEEP_LOOKING)
+                    return result;
+            }
+        }
+    }
+
+    // cache miss
+    return miss(cache, tag, index, action, assoc, protocol);
+}
+
+static bool access_set_generic(cache_t *cache, unsigned long tag, unsigned long index, enum action_t action) {
+    return access_set(cache, tag, index, action, cache->assoc, cache->protocol, cache->tag_index != NULL);
+}
+
+/* Skewed associative access: way w of the block lives in set
+ * skew_index(block, w), and the tag is the whole block number. The
+ * protocol handling is the same as for a set associative cache.
+ */
+static bool access_skewed(cache_t *cache, unsigned long tag, unsigned long index, enum action_t action) {
+    int assoc = cache->assoc;
+    cache->use_clock++;
 
-    unsigned long tag = get_cache_tag(cache, addr);
-    unsigned long index = get_cache_index(cache, addr);
-
-    log_set(index);
-
-    if (cache->protocol == MSI) {
-        return access_cache_msi(cache, tag, index, action);
-    }
-
-    // cache hit
-    for (int i = 0; i < cache->assoc; i++) {
-        if (cache->lines[index][i].tag == tag) {
-            if (cache->lines[index][i].state == VALID) {
-                log_way(i);
-
-                // ignore snoops
-                if (action == LOAD || action == STORE) {
-                    cache->lru_way[index] = (i + 1) % cache->assoc;
-                    update_stats(cache->stats, true, false, false, action);
-
-                    if (action == STORE && !cache->lines[index][i].dirty_f) {
-                        cache->lines[index][i].dirty_f = true;
-                    }
-                }
-
-                // snoops
-                if (cache->protocol == VI && (action == LD_MISS || action == ST_MISS)) {
-                    cache->lines[index][i].state = INVALID;
-                    if (cache->lines[index][i].dirty_f) { // writeback
-                        cache->lines[index][i].dirty_f = false;
-                        update_stats(cache->stats, false, true, false, action);
-                    }
-                }
-
-                return true;
-            } else {
-                if (cache->protocol == VI && (action == LOAD || action == STORE)) {
-                    cache->lines[index][i].state = VALID;
-                }
+    for (int i = 0; i < assoc; i++) {
+        unsigned long set = skew_index(cache, tag, i);
+        if (cache->lines[set][i].tag == tag) {
+            log_set(cache, set);
+            int result = visit_way(cache, set, i, action, assoc, cache->protocol);
+            if (result != KEEP_LOOKING) {
+                if (action == LOAD || action == STORE)
+                    cache->last_use[set * assoc + i] = cache->use_clock;
+                return result;
             }
         }
     }
 
     // cache miss
     if (action == LD_MISS || action == ST_MISS) { // ignore snoops
+        if (cache->victim && snoop_victim(cache, tag, index, action, cache->protocol))
+            return true;
         update_stats(cache->stats, false, false, false, action);
         return false;
     }
 
-    // writeback if line is dirty
-    int lru_way = cache->lru_way[index];
-    update_stats(cache->stats, false, cache->lines[index][lru_way].dirty_f, false, action);
+    // replace an invalid candidate if there is one, else the least recently used
+    int victim = 0;
+    unsigned long victim_set = skew_index(cache, tag, 0);
+    for (int i = 0; i < assoc; i++) {
+        unsigned long set = skew_index(cache, tag, i);
+        if (cache->lines[set][i].state == INVALID) {
+            victim = i;
+            victim_set = set;
+            break;
+        }
+        if (cache->last_use[set * assoc + i] < cache->last_use[victim_set * assoc + victim]) {
+            victim = i;
+            victim_set = set;
+        }
+    }
+
+    log_set(cache, victim_set);
+    cache->last_use[victim_set * assoc + victim] = cache->use_clock;
+    if (cache->victim && victim_hit(cache, tag, victim_set, victim, action, assoc, cache->protocol))
+        return true;
+    if (write_around(cache, action))
+        return false;
 
-    cache->lines[index][lru_way].tag = tag;
-    cache->lines[index][lru_way].dirty_f = action == STORE;
-    cache->lines[index][lru_way].state = VALID;
-    cache->lru_way[index] = (lru_way + 1) % cache->assoc;
+    fill_way(cache, tag, victim_set, victim, action, cache->protocol);
 
     return false;
-}
\ No newline at end of file
+}
+
+#define DEFINE_KERNEL(protocol, assoc)                                                                     \
+    static bool access_set_##protocol##_##assoc(cache_t *cache, unsigned long tag, unsigned long index,   \
+                                                enum action_t action) {                                   \
+        return access_set(cache, tag, index, action, assoc, protocol, false);                             \
+    }
+
+#define DEFINE_KERNELS(protocol) \
+    DEFINE_KERNEL(protocol, 1)   \
+    DEFINE_KERNEL(protocol, 2)   \
+    DEFINE_KERNEL(protocol, 4)   \
+    DEFINE_KERNEL(protocol, 8)   \
+    DEFINE_KERNEL(protocol, 16)
+
+DEFINE_KERNELS(NONE)
+DEFINE_KERNELS(VI)
+DEFINE_KERNELS(MSI)
+
+#define KERNELS(protocol) \
+    { access_set_##protocol##_1, access_set_##protocol##_2, access_set_##protocol##_4, \
+      access_set_##protocol##_8, access_set_##protocol##_16 }
+
+// [protocol][log2(assoc)]
+static const access_fn_t kernels[3][5] = { KERNELS(NONE), KERNELS(VI), KERNELS(MSI) };
+
+/* Picks the specialized kernel for the cache's shape if there is one,
+ * otherwise the generic access path.
+ */
+static access_fn_t select_access_kernel(cache_t *cache) {
+    if (cache->index_fn == INDEX_SKEW)
+        return access_skewed;
+
+    if (cache->tag_index == NULL) {
+        for (int log_assoc = 0; log_assoc < 5; log_assoc++) {
+            if (cache->assoc == 1 << log_assoc)
+                return kernels[cache->protocol][log_assoc];
+        }
+    }
+    return access_set_generic;
+}
+
+static void flush_wc_entry(cache_t *cache, wc_entry_t *entry) {
+    cache->stats->B_write_through += (long)__builtin_popcountll(entry->granule_mask) * cache->wc_granule;
+    cache->stats->n_wc_flushes++;
+    entry->granule_mask = 0;
+}
+
+/* Accounts for the store's word on the bus as if written through. That is
+ * the traffic of a write-through cache, and what one would have cost for
+ * a write-back cache. With a write-combining buffer, stores to a block
+ * already in the buffer merge, and the bus only sees the distinct
+ * granules once the entry is flushed to make room.
+ */
+static void write_through(cache_t *cache, unsigned long addr) {
+    if (cache->wc == NULL) {
+        cache->stats->B_write_through += WORD_SIZE;
+        return;
+    }
+
+    unsigned long block_addr = get_cache_block_addr(cache, addr);
+    uint64_t bit = 1ULL << ((addr - block_addr) / cache->wc_granule);
+
+    // merge into the block's entry, else take an empty or the least recently used one
+    wc_entry_t *entry = &cache->wc[0];
+    for (int i = 0; i < cache->n_wc; i++) {
+        wc_entry_t *e = &cache->wc[i];
+        if (e->granule_mask && e->block_addr == block_addr) {
+            entry = e;
+            break;
+        }
+        if (entry->granule_mask && (!e->granule_mask || e->last_use < entry->last_use))
+            entry = e;
+    }
+
+    if (entry->granule_mask && entry->block_addr != block_addr)
+        flush_wc_entry(cache, entry);
+
+    entry->block_addr = block_addr;
+    entry->granule_mask |= bit;
+    entry->last_use = ++cache->wc_clock;
+}
+
+/* Bytes still waiting in the write-combining buffer. */
+long pending_write_bytes(cache_t *cache) {
+    long bytes = 0;
+    for (int i = 0; i < cache->n_wc; i++)
+        bytes += (long)__builtin_popcountll(cache->wc[i].granule_mask) * cache->wc_granule;
+    return bytes;
+}
+
+/* Flushes the write-combining buffer, at the end of a run. */
+void drain_write_combining(cache_t *cache) {
+    for (int i = 0; i < cache->n_wc; i++) {
+        if (cache->wc[i].granule_mask)
+            flush_wc_entry(cache, &cache->wc[i]);
+    }
+}
+
+/* This method takes a cache, an address, and an action
+ * it proceses the cache access. functionality in no particular order:
+ *   - look up the address in the cache, determine if hit or miss
+ *   - update the LRU_way, cacheTags, state, dirty flags if necessary
+ *   - update the cache statistics (call update_stats)
+ * return true if there was a hit, false if there was a miss
+ * Use the "get" helper functions above. They make your life easier.
+ */
+bool access_cache(cache_t *cache, unsigned long addr, enum action_t action) {
+    if (action == STORE) write_through(cache, addr);
+    return cache->access(cache, get_cache_tag(cache, addr), get_cache_index(cache, addr), action);
+}
+
+/* Processes n accesses to the same cache, in order, exactly as n calls to
+ * access_cache would. The tags and indices of each group of accesses are
+ * computed up front and their sets are prefetched, so that for caches too
+ * big for the host's caches the set lookups overlap instead of stalling
+ * one after the other. hits_out may be NULL.
+ */
+void access_cache_batch(cache_t *cache, const unsigned long *addrs, const enum action_t *actions, int n,
+                        bool *hits_out) {
+    unsigned long tags[PREFETCH_BATCH];
+    unsigned long indices[PREFETCH_BATCH];
+
+    for (int start = 0; start < n; start += PREFETCH_BATCH) {
+        int n_batch = (n - start < PREFETCH_BATCH) ? n - start : PREFETCH_BATCH;
+
+        for (int i = 0; i < n_batch; i++) {
+            tags[i] = get_cache_tag(cache, addrs[start + i]);
+            indices[i] = get_cache_index(cache, addrs[start + i]);
+            PREFETCH(&cache->lines[0][indices[i] * cache->assoc]);
+            PREFETCH(&cache->lru_way[indices[i]]);
+        }
+
+        for (int i = 0; i < n_batch; i++) {
+            if (actions[start + i] == STORE) write_through(cache, addrs[start + i]);
+            bool hit_f = cache->access(cache, tags[i], indices[i], actions[start + i]);
+            if (hits_out) hits_out[start + i] = hit_f;
+        }
+    }
+}
@@ -2,12 +2,15 @@
 #define __CACHE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "cache_stats.h"
+#include "tag_index.h"
 
 #define ADDRESS_SIZE 32  // in bits
 #define HIT 1
 #define MISS 0
+#define WORD_SIZE 4  // trace records carry no size, so every access is taken to be a word
 
 // {INVALID, VALID} for VI, {INVALID, SHARED, MODIFIED} for MSI 
 enum state_t { INVALID, VALID, SHARED, MODIFIED };
@@ -15,6 +18,13 @@ enum state_t { INVALID, VALID, SHARED, MODIFIED };
 // what coherence protocol are we simulating?
 enum protocol_t { NONE, VI, MSI }; 
 
+// how is the set of an address chosen?
+// - INDEX_MOD: block number modulo the number of sets (bit slicing for a power of 2)
+// - INDEX_XOR: block number folded onto itself with xor, then modulo the number of sets
+// - INDEX_PRIME: block number modulo the largest prime <= the number of sets
+// - INDEX_SKEW: skewed associative, every way hashes the block number differently
+enum index_fn_t { INDEX_MOD, INDEX_XOR, INDEX_PRIME, INDEX_SKEW };
+
 typedef struct {
   // tags are big numbers, store them as longs
   unsigned long tag;
@@ -22,7 +32,28 @@ typedef struct {
   enum state_t state;
 } cache_line_t;
 
+// an entry of the victim buffer, line.tag holds the whole block number
+// since the buffer takes lines from every set
+typedef struct {
+  cache_line_t line;
+  unsigned long last_use;
+} victim_line_t;
+
+// an entry of the write-combining buffer, empty while no granule is set
 typedef struct {
+  unsigned long block_addr;
+  uint64_t granule_mask;  // granules of the block written since the last flush
+  unsigned long last_use;
+} wc_entry_t;
+
+typedef struct cache cache_t;
+
+/* Looks up the tag in the set and processes the access, see access_cache.
+ * Each cache is given the access function specialized for its
+ * associativity and protocol when it is created. */
+typedef bool (*access_fn_t)(cache_t *cache, unsigned long tag, unsigned long index, enum action_t action);
+
+struct cache {
   int capacity;    // in Bytes
   int block_size;  // in Bytes
   int assoc;       // 1 for direct mapped, 2 for 2-way set associative, etc.
@@ -32,6 +63,10 @@ typedef struct {
   int n_index_bit;
   int n_tag_bit;
 
+  enum index_fn_t index_fn;
+  int n_index_set;  // sets the index function can reach
+  int tag_shift;    // tag = addr >> tag_shift, the whole block number unless bit slicing
+
 
   // cache lines stored in a 2D Array:
   // - 1st dimension = which set
@@ -42,17 +77,57 @@ typedef struct {
   // only 1 dimension b/c LRU field is for the entire set
   int *lru_way;
 
+  // optional tag -> way index, NULL unless enable_tag_index was called
+  tag_index_t *tag_index;
+
+  // skewed caches have no sets to keep an LRU way for, they replace the
+  // least recently used of the candidate lines instead
+  unsigned long *last_use;  // [set * assoc + way]
+  unsigned long use_clock;
+
+  // optional victim buffer, NULL unless enable_victim_buffer was called
+  victim_line_t *victim;
+  int n_victim;
+  unsigned long victim_clock;
+
+  // write policy, write-back and write-allocate unless set_write_policy was called
+  bool write_through_f;
+  bool write_allocate_f;
+
+  // optional write-combining buffer for the stores written through,
+  // NULL unless enable_write_combining was called
+  wc_entry_t *wc;
+  int n_wc;
+  int wc_granule;  // in Bytes
+  unsigned long wc_clock;
+
   cache_stats_t *stats;
 
   enum protocol_t protocol;
   bool lru_on_invalidate_f;
+
+  // set and way touched by the most recent access, for verbose printing
+  int last_set;
+  int last_way;
+
+  access_fn_t access;
 	
-} cache_t;
+};
 
 cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t protocol, bool lru_on_invalidate_f);
+void free_cache(cache_t *cache);
+void enable_tag_index(cache_t *cache);
+void enable_victim_buffer(cache_t *cache, int n_victim);
+void set_write_policy(cache_t *cache, bool write_through_f, bool write_allocate_f);
+void enable_write_combining(cache_t *cache, int n_wc);
+long pending_write_bytes(cache_t *cache);
+void drain_write_combining(cache_t *cache);
+void set_cache_index_fn(cache_t *cache, enum index_fn_t index_fn);
 unsigned long get_cache_tag(cache_t *cache, unsigned long addr);
 unsigned long get_cache_index(cache_t *cache, unsigned long addr);
 unsigned long get_cache_block_addr(cache_t *cache, unsigned long addr);
 bool access_cache(cache_t *cache, unsigned long addr, enum action_t action);
+void access_cache_batch(cache_t *cache, const unsigned long *addrs, const enum action_t *actions, int n,
+                        bool *hits_out);
 
 #endif  // CACHE
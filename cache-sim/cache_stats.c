@@ -12,12 +12,16 @@ cache_stats_t *make_cache_stats() {
     stats->n_hits = 0;
     stats->n_stores = 0;
     stats->n_writebacks = 0;
+    stats->n_fills = 0;
 
     stats->n_bus_snoops = 0;
     stats->n_snoop_hits = 0;
 
     stats->n_upgrade_miss = 0;
 
+    stats->n_victim_hits = 0;
+    stats->n_victim_dirty_hits = 0;
+
     stats->hit_rate = 0.0;
 
     stats->B_bus_to_cache = 0;
@@ -28,6 +32,12 @@ cache_stats_t *make_cache_stats() {
     stats->B_total_traffic_wb = 0;
     stats->B_total_traffic_wt = 0;
 
+    stats->B_victim_saved = 0;
+
+    stats->B_write_through = 0;
+    stats->B_write_around = 0;
+    stats->n_wc_flushes = 0;
+
     return stats;
 }
 
@@ -64,9 +74,10 @@ void calculate_stat_rates(cache_stats_t *stats, int block_size) {
 
     stats->hit_rate = stats->n_hits / (double)stats->n_cpu_accesses;
 
-    stats->B_bus_to_cache = block_size * (stats->n_cpu_accesses - stats->n_hits);
-    stats->B_cache_to_bus_wb = block_size * stats->n_writebacks;
-    stats->B_cache_to_bus_wt = 4 * stats->n_stores;
+    stats->B_bus_to_cache = block_size * stats->n_fills;
+    stats->B_cache_to_bus_wb = block_size * stats->n_writebacks + stats->B_write_around;
+    stats->B_cache_to_bus_wt = stats->B_write_through;
     stats->B_total_traffic_wb = stats->B_bus_to_cache + stats->B_cache_to_bus_wb;
     stats->B_total_traffic_wt = stats->B_bus_to_cache + stats->B_cache_to_bus_wt;
+    stats->B_victim_saved = block_size * (stats->n_victim_hits + stats->n_victim_dirty_hits);
 }
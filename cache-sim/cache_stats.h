@@ -11,11 +11,15 @@ typedef struct {
     long n_hits;
     long n_stores;
     long n_writebacks;
+    long n_fills;  // blocks brought in from the bus
 
     long n_bus_snoops; // num times you snoop an event from another core
     long n_snoop_hits; // num times a bus event occurs for a valid line in your cache
     long n_upgrade_miss;
 
+    long n_victim_hits;        // misses caught by the victim buffer, also counted in n_hits
+    long n_victim_dirty_hits;  // ... of which dirty, so their writeback was saved too
+
     double hit_rate;
 
     long B_bus_to_cache;  
@@ -26,6 +30,12 @@ typedef struct {
     long B_total_traffic_wb;  // write-back
     long B_total_traffic_wt;  // write-thru
 
+    long B_victim_saved;  // bus traffic the victim buffer avoided
+
+    long B_write_through;  // stores written through, after combining (what-if under write-back)
+    long B_write_around;   // store misses sent straight to memory by write-back, no-allocate
+    long n_wc_flushes;     // write-combining buffer entries written out
+
 } cache_stats_t;
 
 cache_stats_t *make_cache_stats();
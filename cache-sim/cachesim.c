@@ -0,0 +1,87 @@
+#include <stdlib.h>
+
+#include "cachesim.h"
+#include "simulator.h"
+
+struct cachesim {
+    simulator_t *sim;
+};
+
+static bool is_power_of_2(int x) {
+    return x > 0 && (x & (x - 1)) == 0;
+}
+
+cachesim_t *cachesim_create(const cachesim_config_t *config) {
+    if (config->n_core < 1 || config->n_core > 32 ||
+            config->capacity <= 0 || !is_power_of_2(config->block_size) || config->assoc < 1 ||
+            config->capacity % (config->block_size * config->assoc) != 0 ||
+            config->capacity / config->block_size / config->assoc == 0 || config->n_victim < 0 ||
+            config->n_write_combining < 0 ||
+            (unsigned)config->protocol > MSI || (unsigned)config->index_fn > INDEX_SKEW) {
+        return NULL;
+    }
+
+    cachesim_t *cachesim = malloc(sizeof(cachesim_t));
+    cachesim->sim = make_simulator();
+
+    cachesim->sim->n_core = config->n_core;
+    cachesim->sim->capacity = config->capacity;
+    cachesim->sim->block_size = config->block_size;
+    cachesim->sim->assoc = config->assoc;
+    cachesim->sim->protocol = config->protocol;
+    cachesim->sim->lru_on_invalidate_f = config->lru_on_invalidate_f;
+    cachesim->sim->index_fn = config->index_fn;
+    cachesim->sim->n_victim = config->n_victim;
+    cachesim->sim->write_through_f = config->write_through_f;
+    cachesim->sim->write_allocate_f = !config->no_write_allocate_f;
+    cachesim->sim->n_write_combining = config->n_write_combining;
+
+    init_simulator(cachesim->sim);
+
+    return cachesim;
+}
+
+static bool is_valid_core(cachesim_t *cachesim, int core) {
+    return core >= 0 && core < cachesim->sim->n_core;
+}
+
+bool cachesim_access(cachesim_t *cachesim, int core, unsigned long addr, enum action_t action) {
+    if (!is_valid_core(cachesim, core))
+        return false;
+    return simulate_access(cachesim->sim, core, addr, action);
+}
+
+void cachesim_access_batch(cachesim_t *cachesim, const int *cores, const unsigned long *addrs,
+                           const enum action_t *actions, int n, bool *hits_out) {
+    // with a single core nothing is snooped, so the cache can take the
+    // whole batch at once and prefetch ahead, unless some access is by
+    // another core and has to be skipped
+    bool single_core_f = cachesim->sim->n_core == 1 && cachesim->sim->sharing == NULL;
+    for (int i = 0; single_core_f && i < n; i++) {
+        single_core_f = cores[i] == 0;
+    }
+    if (single_core_f) {
+        access_cache_batch(cachesim->sim->cache[0], addrs, actions, n, hits_out);
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        bool hit_f = cachesim_access(cachesim, cores[i], addrs[i], actions[i]);
+        if (hits_out) hits_out[i] = hit_f;
+    }
+}
+
+void cachesim_get_stats(cachesim_t *cachesim, int core, cache_stats_t *stats) {
+    if (!is_valid_core(cachesim, core))
+        return;
+
+    cache_t *cache = cachesim->sim->cache[core];
+    *stats = *cache->stats;
+    stats->B_write_through += pending_write_bytes(cache);  // as if the buffer were drained now
+    calculate_stat_rates(stats, cache->block_size);
+}
+
+void cachesim_destroy(cachesim_t *cachesim) {
+    free_simulator(cachesim->sim);
+    free(cachesim);
+}
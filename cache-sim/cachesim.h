@@ -0,0 +1,53 @@
+#ifndef __CACHESIM_H
+#define __CACHESIM_H
+
+/*
+ * libcachesim: the cache simulator as an embeddable library.
+ *
+ * Every simulator is an independent instance with no global state, so
+ * any number of them can be driven concurrently from different threads
+ * (a single instance must not be shared between threads without locking).
+ */
+
+#include <stdbool.h>
+#include "cache.h"
+#include "cache_stats.h"
+
+typedef struct cachesim cachesim_t;
+
+typedef struct {
+  int n_core;
+  int capacity;    // in Bytes, a multiple of block_size * assoc
+  int block_size;  // in Bytes, power of 2
+  int assoc;       // 1 for direct mapped, 2 for 2-way set associative, etc.
+  enum protocol_t protocol;
+  bool lru_on_invalidate_f;
+  enum index_fn_t index_fn;  // INDEX_MOD (0) unless set
+  int n_victim;              // victim buffer lines behind each cache, 0 for none
+  bool write_through_f;      // write-back unless set
+  bool no_write_allocate_f;  // write-allocate unless set
+  int n_write_combining;     // write-combining buffer entries per cache, 0 for none
+} cachesim_config_t;
+
+/* Returns a new simulator, or NULL if the configuration is invalid. */
+cachesim_t *cachesim_create(const cachesim_config_t *config);
+
+/* Simulates one LOAD or STORE by core, returns true on a hit. Returns
+ * false without simulating anything if core is not in [0, n_core).
+ */
+bool cachesim_access(cachesim_t *sim, int core, unsigned long addr, enum action_t action);
+
+/* Simulates n accesses in order, skipping those by an invalid core.
+ * hits_out may be NULL.
+ */
+void cachesim_access_batch(cachesim_t *sim, const int *cores, const unsigned long *addrs,
+                           const enum action_t *actions, int n, bool *hits_out);
+
+/* Copies core's statistics, with the rates calculated, into stats. Leaves
+ * stats untouched if core is not in [0, n_core).
+ */
+void cachesim_get_stats(cachesim_t *sim, int core, cache_stats_t *stats);
+
+void cachesim_destroy(cachesim_t *sim);
+
+#endif  // CACHESIM
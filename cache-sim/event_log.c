@@ -0,0 +1,128 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "event_log.h"
+
+#define CHUNK_EVENTS 4096  // events handed to the writer at a time
+#define N_CHUNK 64         // chunks in the ring (10MB of 40 byte events)
+
+struct event_log {
+    FILE *file;
+
+    log_event_t *ring;  // N_CHUNK chunks of CHUNK_EVENTS events
+    int fill;           // events in the chunk currently being filled
+
+    // chunk counters, guarded by lock. Chunks [tail, head) are full and
+    // waiting for the writer, chunk head is being filled by the producer.
+    long head;
+    long tail;
+    bool closing_f;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;  // signalled when a chunk is full or on close
+    pthread_cond_t space;  // signalled when the writer frees a chunk
+    pthread_t writer;
+};
+
+static log_event_t *chunk(event_log_t *log, long n) {
+    return &log->ring[(n % N_CHUNK) * CHUNK_EVENTS];
+}
+
+static void *write_chunks(void *arg) {
+    event_log_t *log = arg;
+
+    pthread_mutex_lock(&log->lock);
+    while (true) {
+        while (log->tail == log->head && !log->closing_f)
+            pthread_cond_wait(&log->ready, &log->lock);
+        if (log->tail == log->head)
+            break;
+
+        // the chunk is not touched by the producer until tail moves past it
+        pthread_mutex_unlock(&log->lock);
+        fwrite(chunk(log, log->tail), sizeof(log_event_t), CHUNK_EVENTS, log->file);
+        pthread_mutex_lock(&log->lock);
+
+        log->tail++;
+        pthread_cond_signal(&log->space);
+    }
+    pthread_mutex_unlock(&log->lock);
+
+    return NULL;
+}
+
+event_log_t *open_event_log(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return NULL;
+
+    uint32_t event_size = sizeof(log_event_t);
+    fwrite(EVENT_LOG_MAGIC, 1, sizeof(EVENT_LOG_MAGIC), file);
+    fwrite(&event_size, sizeof(event_size), 1, file);
+
+    event_log_t *log = malloc(sizeof(event_log_t));
+    log->file = file;
+    log->ring = malloc(N_CHUNK * CHUNK_EVENTS * sizeof(log_event_t));
+    log->fill = 0;
+    log->head = 0;
+    log->tail = 0;
+    log->closing_f = false;
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->ready, NULL);
+    pthread_cond_init(&log->space, NULL);
+    pthread_create(&log->writer, NULL, write_chunks, log);
+
+    return log;
+}
+
+void log_event(event_log_t *log, const log_event_t *event) {
+    chunk(log, log->head)[log->fill++] = *event;
+    if (log->fill < CHUNK_EVENTS)
+        return;
+
+    // hand the full chunk over and wait if the ring has no free chunk left
+    pthread_mutex_lock(&log->lock);
+    log->head++;
+    pthread_cond_signal(&log->ready);
+    while (log->head - log->tail >= N_CHUNK)
+        pthread_cond_wait(&log->space, &log->lock);
+    pthread_mutex_unlock(&log->lock);
+
+    log->fill = 0;
+}
+
+/* Waits for the writer to drain every full chunk, then writes out the
+ * partially filled one and closes the file.
+ */
+void close_event_log(event_log_t *log) {
+    pthread_mutex_lock(&log->lock);
+    log->closing_f = true;
+    pthread_cond_signal(&log->ready);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->writer, NULL);
+
+    fwrite(chunk(log, log->head), sizeof(log_event_t), log->fill, log->file);
+    fclose(log->file);
+
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->ready);
+    pthread_cond_destroy(&log->space);
+    free(log->ring);
+    free(log);
+}
+
+bool read_log_header(FILE *file) {
+    char magic[sizeof(EVENT_LOG_MAGIC)];
+    uint32_t event_size;
+
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+            fread(&event_size, sizeof(event_size), 1, file) != 1)
+        return false;
+    return memcmp(magic, EVENT_LOG_MAGIC, sizeof(magic)) == 0 && event_size == sizeof(log_event_t);
+}
+
+bool read_log_event(FILE *file, log_event_t *event) {
+    return fread(event, sizeof(log_event_t), 1, file) == 1;
+}
@@ -0,0 +1,41 @@
+#ifndef __EVENT_LOG_H
+#define __EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define EVENT_LOG_MAGIC "P5LOG01"
+
+// everything print_insn_info needs to reproduce a verbose line
+typedef struct {
+  uint64_t addr;
+  uint64_t block_addr;
+  int32_t set;
+  int32_t way;
+  uint8_t core;
+  char cmd;  // 'r' or 'w', as in the trace
+  uint8_t hit_f;
+  uint8_t state;  // enum state_t of the line after the access
+  uint8_t dirty_f;
+  uint8_t pad[7];
+} log_event_t;
+
+/* Internal representation of an event log, defined in event_log.c.
+ * Events are appended to a ring of chunks which a writer thread flushes
+ * to the file, so logging an event never waits on I/O unless the writer
+ * falls a whole ring behind.
+ */
+typedef struct event_log event_log_t;
+
+event_log_t *open_event_log(const char *path);
+void log_event(event_log_t *log, const log_event_t *event);
+void close_event_log(event_log_t *log);
+
+/* Reading side, used by the p5_log pretty-printer. read_log_header returns
+ * false if the file is not an event log. read_log_event returns false at EOF.
+ */
+bool read_log_header(FILE *file);
+bool read_log_event(FILE *file, log_event_t *event);
+
+#endif  // EVENT_LOG
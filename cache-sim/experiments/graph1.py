@@ -18,6 +18,8 @@ protocol='none'
 
 expname='exp1'
 figname='graph1.png'
+# results of points already simulated, shared by every experiment
+memo_dir='results/memo'
 
 
 def get_stats(logfile, key):
@@ -29,8 +31,8 @@ def get_stats(logfile, key):
 
 def run_exp(logfile, core, cap, bsize, assoc):
     trace = 'trace.%dt.long.txt' % core
-    cmd="../p5 -t %s -p %s -n %d -cache %d %d %d >> %s" % (
-            trace, protocol, core, cap, bsize, assoc, logfile)
+    cmd="../p5 -t %s -p %s -n %d -cache %d %d %d -memo %s >> %s" % (
+            trace, protocol, core, cap, bsize, assoc, memo_dir, logfile)
     print(cmd)
     os.system(cmd)
 
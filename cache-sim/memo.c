@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "memo.h"
+
+#define MEMO_MAGIC "P5MEMO1"
+#define MEMO_KEY_SIZE 512
+#define FNV_OFFSET 0xcbf29ce484222325UL
+#define FNV_PRIME 0x100000001b3UL
+
+static unsigned long fnv1a(unsigned long hash, const unsigned char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Hashes the whole trace file, returns false if it cannot be read. */
+static bool hash_trace(const char *trace_path, unsigned long *hash) {
+    FILE *trace = fopen(trace_path, "rb");
+    if (trace == NULL)
+        return false;
+
+    unsigned char buf[1 << 16];
+    size_t n;
+    *hash = FNV_OFFSET;
+    while ((n = fread(buf, 1, sizeof(buf), trace)) > 0)
+        *hash = fnv1a(*hash, buf, n);
+
+    fclose(trace);
+    return true;
+}
+
+/* Describes the trace and every option that changes the statistics.
+ * Options that only change how the simulation runs (tag_index_assoc)
+ * are left out, so they share results.
+ */
+static bool memo_key(simulator_t *sim, const char *trace_path, char *key, size_t size) {
+    unsigned long trace_hash;
+    if (!hash_trace(trace_path, &trace_hash))
+        return false;
+
+    snprintf(key, size,
+            "%s trace=%016lx stats=%zu n_core=%d protocol=%d capacity=%d block_size=%d assoc=%d "
+            "index_fn=%d lru_on_invalidate=%d victim=%d write_through=%d write_allocate=%d wc=%d timed=%d limit=%d "
+            "converge=%g/%ld/%d",
+            MEMO_MAGIC, trace_hash, sizeof(cache_stats_t), sim->n_core, sim->protocol, sim->capacity,
+            sim->block_size, sim->assoc, sim->index_fn, sim->lru_on_invalidate_f, sim->n_victim,
+            sim->write_through_f, sim->write_allocate_f, sim->n_write_combining, sim->timed_f,
+            sim->limit_insn_f ? sim->insn_limit : -1, sim->converge_f ? sim->converge_eps : -1,
+            sim->converge_window, sim->converge_n_window);
+    return true;
+}
+
+static char *memo_path(simulator_t *sim, const char *key) {
+    unsigned long hash = fnv1a(FNV_OFFSET, (const unsigned char *)key, strlen(key));
+    char *path = malloc(strlen(sim->memo_dir) + 32);
+    sprintf(path, "%s/%016lx.memo", sim->memo_dir, hash);
+    return path;
+}
+
+bool memo_load(simulator_t *sim, const char *trace_path, memo_run_t *run) {
+    char key[MEMO_KEY_SIZE];
+    if (!memo_key(sim, trace_path, key, sizeof(key)))
+        return false;
+
+    char *path = memo_path(sim, key);
+    FILE *file = fopen(path, "rb");
+    free(path);
+    if (file == NULL)
+        return false;
+
+    // the stored key must match exactly, not just its hash
+    char stored_key[MEMO_KEY_SIZE];
+    bool hit_f = fgets(stored_key, sizeof(stored_key), file) != NULL &&
+                 strncmp(stored_key, key, strlen(key)) == 0 && stored_key[strlen(key)] == '\n' &&
+                 fread(run, sizeof(memo_run_t), 1, file) == 1;
+
+    cache_stats_t *stats = malloc(sim->n_core * sizeof(cache_stats_t));
+    hit_f = hit_f && fread(stats, sizeof(cache_stats_t), sim->n_core, file) == (size_t)sim->n_core;
+    if (hit_f) {
+        for (int i = 0; i < sim->n_core; i++)
+            *sim->cache[i]->stats = stats[i];
+    }
+
+    free(stats);
+    fclose(file);
+    return hit_f;
+}
+
+void memo_store(simulator_t *sim, const char *trace_path, const memo_run_t *run) {
+    char key[MEMO_KEY_SIZE];
+    if (!memo_key(sim, trace_path, key, sizeof(key)))
+        return;
+
+    mkdir(sim->memo_dir, 0777);  // fails harmlessly if it exists
+
+    // write to a temporary file and rename it into place, so that
+    // concurrent runs never see a partial result
+    char *path = memo_path(sim, key);
+    char *tmp_path = malloc(strlen(path) + 32);
+    sprintf(tmp_path, "%s.%d.tmp", path, (int)getpid());
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (file != NULL) {
+        bool ok_f = fprintf(file, "%s\n", key) > 0 && fwrite(run, sizeof(memo_run_t), 1, file) == 1;
+        for (int i = 0; i < sim->n_core && ok_f; i++)
+            ok_f = fwrite(sim->cache[i]->stats, sizeof(cache_stats_t), 1, file) == 1;
+
+        if (fclose(file) == 0 && ok_f)
+            rename(tmp_path, path);
+        else
+            remove(tmp_path);
+    }
+
+    free(tmp_path);
+    free(path);
+}
@@ -0,0 +1,33 @@
+#ifndef __MEMO_H
+#define __MEMO_H
+
+#include <stdbool.h>
+#include "simulator.h"
+
+/*
+ * On-disk store of simulation results, so rerunning an experiment point
+ * that was already simulated just prints the stored statistics.
+ *
+ * A result is keyed by a hash of the trace's contents and every option
+ * that changes the statistics, see memo_key. Runs that print more than
+ * the statistics (verbose, event log, sharing report) are never memoized.
+ */
+
+// what process_trace needs besides the caches' statistics to print the results
+typedef struct {
+  long total_insn;
+  bool limit_reached_f;
+  bool converged_f;
+} memo_run_t;
+
+/* Looks up the result for the simulator's configuration on the given trace
+ * file. On a hit, fills in each cache's statistics and run, returns true.
+ */
+bool memo_load(simulator_t *sim, const char *trace_path, memo_run_t *run);
+
+/* Stores the result of a finished run. Failures to write are ignored,
+ * the result is just simulated again next time.
+ */
+void memo_store(simulator_t *sim, const char *trace_path, const memo_run_t *run);
+
+#endif  // MEMO
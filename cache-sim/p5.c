@@ -5,22 +5,39 @@
 #include "print_helpers.h"
 #include "simulator.h"
 
-int capacity;
-int block_size;
-int assoc;
-
 void printUsage() {
     printf("\nUsage: ./p5 [-hv] -t <tracename> -l <limit> -n_cores <n> -cache <cap> <bsize> <assoc>\n");
     printf("Options:\n");
     printf("  -h|help                         Print this help message\n");
     printf("  -v|verbose                      Optional printing of each insn\n");
+    printf("  -e|event_log <file>             Log each insn to a binary file, print with ./p5_log\n");
     printf("  -n|n_core <n>                  How many cores to simulate\n");
     printf("  -c|cache <cap> <bsize> <assoc>  Set the cache configuration. <cap> "
             "and <bsize> are given as the log of the value.\n");
+    printf("  -z|size <cap> <bsize> <assoc>   Like -cache, but <cap> and <bsize> are in bytes, with an "
+            "optional K or M suffix (ex. 48K, 1.5M)\n");
+    printf("  -f|index_fn mod|xor|prime|skew  how addresses map to sets (default mod)\n");
     printf("  -p|protocol none|vi|msi         which coherence protocol\n");
     printf("  -t|trace <tracename>            Name of trace \n");
+    printf("  -o|timed                        Interleave the cores by the optional 4th (time) field "
+            "of each record.\n"
+            "                                  A %%d in the trace name reads one trace per core\n");
     printf("  -i|lru_on_invalidate            update LRU on line invalidation\n");
+    printf("  -x|tag_index <n>                hash the tags of caches more than n-way "
+            "associative (default %d)\n", DEFAULT_TAG_INDEX_ASSOC);
+    printf("  -k|sockets <n>                  Split the cores into n sockets joined by a directory\n");
+    printf("  -L|socket_latency <local> <remote>  Miss latency in cycles within / across sockets "
+            "(default %d %d)\n", DEFAULT_LOCAL_LATENCY, DEFAULT_REMOTE_LATENCY);
+    printf("  -T|tlb 4K|2M|1G                 Translate through a dTLB and STLB for this page size\n");
+    printf("  -w|write wb|wt alloc|noalloc    Write policy (default wb alloc)\n");
+    printf("  -W|write_combining <n>          Merge stores through an n entry write-combining buffer\n");
+    printf("  -b|victim <n>                   Put an n line victim buffer behind each cache\n");
+    printf("  -m|memo <dir>                   Reuse results stored in <dir> by earlier identical runs\n");
+    printf("  -P|profile [perf]               Time the phases of the run, with perf counters if asked\n");
     printf("  -l|limit <n>                    Simulate only first n insns \n");
+    printf("  -g|converge <eps> <window> <k>  Stop once the hit rate moved by at most eps %% "
+            "in k windows of <window> insns in a row\n");
+    printf("  -s|sharing <n>                  Report the n blocks with the most coherence traffic\n");
     printf("\nExamples:\n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 9 5 1 \n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 12 6 2 \n");
@@ -35,12 +52,41 @@ void printUsage() {
     printf(
             "  -cache 16 4 2   Creates a 2-way set "
             "associative cache with a capacity of 64KB and block size of 16B\n");
+    printf(
+            "  -size 48K 64 3   Creates a 3-way set "
+            "associative cache with a capacity of 48KB and block size of 64B\n");
 }
 
 void suggest_help(){
     printf("Need help? try shell>  ./p5 -help\n");
 }
 
+/*
+ * Parses a size in bytes such as 512, 48K, 1.5M or 1G.
+ * Returns -1 if the size is not a whole number of bytes.
+ */
+long parse_size(char *size) {
+    char *suffix;
+    double bytes = strtod(size, &suffix);
+
+    if (*suffix == 'K' || *suffix == 'k') {
+        bytes *= 1024;
+        suffix++;
+    } else if (*suffix == 'M' || *suffix == 'm') {
+        bytes *= 1024 * 1024;
+        suffix++;
+    } else if (*suffix == 'G' || *suffix == 'g') {
+        bytes *= 1024 * 1024 * 1024;
+        suffix++;
+    }
+    if (*suffix == 'B' || *suffix == 'b')
+        suffix++;
+
+    if (*suffix != '\0' || bytes != (long)bytes)
+        return -1;
+    return (long)bytes;
+}
+
 int parse_args(char **args, int num_args, simulator_t *sim) {
     int i = 0;
     char *arg;
@@ -62,6 +108,11 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
             sim->verbose_f = 1;
         }
 
+        // -event_log p5.log
+        if (strcmp(arg, "-event_log") == 0 || strcmp(arg, "-e") == 0) {
+            sim->event_log_path = args[i++];
+        }
+
         // -n_core
         if (strcmp(arg, "-n_core") == 0 || strcmp(arg, "-n") == 0) {
             sim->n_core = atoi(args[i++]);
@@ -76,10 +127,10 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
                 exit(1);
             }
             int log_cap = atoi(args[i++]);
-            capacity = 1 << log_cap;
+            int capacity = 1 << log_cap;
             int log_block_size = atoi(args[i++]);
-            block_size = 1 << log_block_size;
-            assoc = atoi(args[i++]);
+            int block_size = 1 << log_block_size;
+            int assoc = atoi(args[i++]);
             if (log_cap > 25 || log_cap < 0 || log_block_size > 25 ||
                     log_block_size < 0 || assoc == 0) {
                 printf(
@@ -96,9 +147,63 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
                 suggest_help();
                 exit(1);
             }
+            sim->capacity = capacity;
+            sim->block_size = block_size;
+            sim->assoc = assoc;
             cache_specified = true;
         }
 
+        // -size C B A
+        if (strcmp(arg, "-size") == 0 || strcmp(arg, "-z") == 0) {
+            if (i + 3 > num_args) {
+                printf("Cache description incomplete. Capacity, block size, "
+                        "and associativity must be specified.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+            long capacity = parse_size(args[i++]);
+            long block_size = parse_size(args[i++]);
+            int assoc = atoi(args[i++]);
+            if (capacity <= 0 || capacity > (1 << 30) || block_size <= 0 ||
+                    (block_size & (block_size - 1)) != 0 || assoc <= 0) {
+                printf(
+                        "Cache description invalid. Capacity must be between 1B and 1GB, "
+                        "block size must be a power of 2. Associativity must be "
+                        "non-zero.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+            if (capacity % (block_size * assoc) != 0 || capacity / block_size / assoc == 0) {
+                printf(
+                        "Cache description invalid. Capacity must be a multiple of "
+                        "block size * associativity.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+            sim->capacity = capacity;
+            sim->block_size = block_size;
+            sim->assoc = assoc;
+            cache_specified = true;
+        }
+
+        // -index_fn mod|xor|prime|skew
+        if (strcmp(arg, "-index_fn") == 0 || strcmp(arg, "-f") == 0) {
+            char *index_fn = args[i++];
+            if (strcmp(index_fn, "mod") == 0)
+                sim->index_fn = INDEX_MOD;
+            else if (strcmp(index_fn, "xor") == 0)
+                sim->index_fn = INDEX_XOR;
+            else if (strcmp(index_fn, "prime") == 0)
+                sim->index_fn = INDEX_PRIME;
+            else if (strcmp(index_fn, "skew") == 0)
+                sim->index_fn = INDEX_SKEW;
+            else {
+                printf("unsupported index function.\nExiting....\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
         // -protocol none|vi|msi
         if (strcmp(arg, "-protocol") == 0 || strcmp(arg, "-p") == 0) {
             char *protocol = args[i++];
@@ -120,16 +225,101 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
             sim->trace = args[i++];
         }
 
+        // -timed
+        if (strcmp(arg, "-timed") == 0 || strcmp(arg, "-o") == 0) {
+            sim->timed_f = true;
+        }
+
         // -lru_on_invalidate
         if (strcmp(arg, "-lru_on_invalidate") == 0 || strcmp(arg, "-i") == 0) {
             sim->lru_on_invalidate_f = true;
         }
 
+        // -tag_index 16
+        if (strcmp(arg, "-tag_index") == 0 || strcmp(arg, "-x") == 0) {
+            sim->tag_index_assoc = atoi(args[i++]);
+        }
+
+        // -sockets 2
+        if (strcmp(arg, "-sockets") == 0 || strcmp(arg, "-k") == 0) {
+            sim->n_socket = atoi(args[i++]);
+        }
+
+        // -socket_latency 100 300
+        if (strcmp(arg, "-socket_latency") == 0 || strcmp(arg, "-L") == 0) {
+            sim->local_latency = atoi(args[i++]);
+            sim->remote_latency = atoi(args[i++]);
+        }
+
+        // -tlb 2M
+        if (strcmp(arg, "-tlb") == 0 || strcmp(arg, "-T") == 0) {
+            sim->page_size = parse_size(args[i++]);
+            if (!is_valid_page_size(sim->page_size)) {
+                printf("unsupported page size, use 4K, 2M or 1G.\nExiting....\n");
+                exit(1);
+            }
+        }
+
+        // -write wt noalloc
+        if (strcmp(arg, "-write") == 0 || strcmp(arg, "-w") == 0) {
+            char *hit_policy = args[i++];
+            char *miss_policy = args[i++];
+            if ((strcmp(hit_policy, "wb") != 0 && strcmp(hit_policy, "wt") != 0) ||
+                    (strcmp(miss_policy, "alloc") != 0 && strcmp(miss_policy, "noalloc") != 0)) {
+                printf("unsupported write policy.\nExiting....\n");
+                exit(1);
+            }
+            sim->write_through_f = strcmp(hit_policy, "wt") == 0;
+            sim->write_allocate_f = strcmp(miss_policy, "alloc") == 0;
+        }
+
+        // -write_combining 4
+        if (strcmp(arg, "-write_combining") == 0 || strcmp(arg, "-W") == 0) {
+            sim->n_write_combining = atoi(args[i++]);
+        }
+
+        // -victim 8
+        if (strcmp(arg, "-victim") == 0 || strcmp(arg, "-b") == 0) {
+            sim->n_victim = atoi(args[i++]);
+        }
+
+        // -memo results/memo
+        if (strcmp(arg, "-memo") == 0 || strcmp(arg, "-m") == 0) {
+            sim->memo_dir = args[i++];
+        }
+
         // -limit 100
         if (strcmp(arg, "-limit") == 0 || strcmp(arg, "-l") == 0) {
             sim->limit_insn_f = true;
             sim->insn_limit = atoi(args[i++]);
         }
+
+        // -converge 0.01 10000 5
+        if (strcmp(arg, "-converge") == 0 || strcmp(arg, "-g") == 0) {
+            sim->converge_f = true;
+            sim->converge_eps = atof(args[i++]);
+            sim->converge_window = atol(args[i++]);
+            sim->converge_n_window = atoi(args[i++]);
+            if (sim->converge_window <= 0 || sim->converge_n_window <= 0) {
+                printf("convergence window and count must be positive.\nExiting....\n");
+                exit(1);
+            }
+        }
+
+        // -profile, -profile perf
+        if (strcmp(arg, "-profile") == 0 || strcmp(arg, "-P") == 0) {
+            sim->profile_f = true;
+            if (i < num_args && strcmp(args[i], "perf") == 0) {
+                sim->profile_perf_f = true;
+                i++;
+            }
+        }
+
+        // -sharing 10
+        if (strcmp(arg, "-sharing") == 0 || strcmp(arg, "-s") == 0) {
+            sim->sharing_f = true;
+            sim->sharing_top_n = atoi(args[i++]);
+        }
     }
 
     if (!cache_specified) {
@@ -138,6 +328,18 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
         exit(1);
     }
 
+    if (sim->n_socket < 1 || sim->n_core % sim->n_socket != 0) {
+        printf("%d cores cannot be split evenly into %d sockets\n", sim->n_core, sim->n_socket);
+        suggest_help();
+        exit(1);
+    }
+
+    if (sim->trace == NULL) {
+        printf("No trace specified. Please use the -trace flag\n");
+        suggest_help();
+        exit(1);
+    }
+
     return 1;
 }
 
@@ -145,13 +347,12 @@ int main(int argc, char *argv[]) {
     simulator_t *sim = make_simulator();
 
     if (parse_args(argv, argc, sim)) {
-        sim->cache = malloc(sim->n_core * sizeof(cache_t*));
-        for (int i = 0; i < sim->n_core; i++){
-            sim->cache[i] = make_cache(capacity, block_size, assoc, sim->protocol, sim->lru_on_invalidate_f);
-        }
+        init_simulator(sim);
         print_simulator_header(sim);
         process_trace(sim);  // this is still where the action takes place
     }
 
+    free_simulator(sim);
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "event_log.h"
+#include "print_helpers.h"
+
+/*
+ * Pretty-prints an event log written by ./p5 -event_log <file>,
+ * producing the same lines as a ./p5 -verbose run.
+ */
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        printf("Usage: ./p5_log <logfile>\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        printf("File \'%s\' not found\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (!read_log_header(file)) {
+        printf("\'%s\' is not a p5 event log\n", argv[1]);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    log_event_t event;
+    while (read_log_event(file, &event)) {
+        print_log_event(&event);
+    }
+
+    fclose(file);
+    return EXIT_SUCCESS;
+}
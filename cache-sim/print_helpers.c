@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "cache.h"
 #include "cache_stats.h"
@@ -6,17 +8,14 @@
 #include "print_helpers.h"
 
 
-/* fields you might want to have print */
-int print_set = 0;
-int print_way = 0;
-
-
-void log_set(int set) {
-  print_set = set;
+/* fields you might want to have print, kept per cache so that
+ * independent simulators never share state */
+void log_set(cache_t *cache, int set) {
+  cache->last_set = set;
 }
 
-void log_way(int way) {
-  print_way = way;
+void log_way(cache_t *cache, int way) {
+  cache->last_way = way;
 }
 
 
@@ -32,6 +31,14 @@ void print_simulator_header(simulator_t *sim) {
     printf("none\n");
   }
   print_cache_config(sim->cache[0]); // caches must be identical, so [0] is fine
+  if (sim->mmu) {
+    printf("page_size \t\t%ld B\n", sim->page_size);
+  }
+  if (sim->topology) {
+    printf("sockets \t\t%d x %d cores\n", sim->topology->n_socket, sim->topology->cores_per_socket);
+    printf("miss latency \t\t%d local, %d remote\n", sim->topology->local_latency,
+           sim->topology->remote_latency);
+  }
 }
 
 void print_stats(cache_stats_t *stats, int core) {
@@ -52,6 +59,35 @@ void print_stats(cache_stats_t *stats, int core) {
   printf("%d.B_written_cache_to_bus_wt \t%ld\n", core, stats->B_cache_to_bus_wt);
   printf("%d.B_total_traffic_wb \t%ld\n", core, stats->B_total_traffic_wb);
   printf("%d.B_total_traffic_wt \t%ld\n", core, stats->B_total_traffic_wt);
+}
+
+void print_victim_stats(cache_stats_t *stats, int core) {
+  printf("%d.n_victim_hits \t%ld\n", core, stats->n_victim_hits);
+  printf("%d.n_victim_dirty_hits \t%ld\n", core, stats->n_victim_dirty_hits);
+  printf("%d.B_saved_by_victim \t%ld\n", core, stats->B_victim_saved);
+}
+
+void print_write_policy_stats(cache_stats_t *stats, int core) {
+  printf("%d.n_fills \t\t%ld\n", core, stats->n_fills);
+  printf("%d.B_write_through \t%ld\n", core, stats->B_write_through);
+  printf("%d.B_write_around \t%ld\n", core, stats->B_write_around);
+  printf("%d.n_wc_flushes \t%ld\n", core, stats->n_wc_flushes);
+}
+
+/* The STLB miss rate is out of the dTLB misses, which are all it sees. */
+void print_tlb_stats(tlb_stats_t *stats, int core, int block_size) {
+  long n_dtlb_misses = stats->n_accesses - stats->n_dtlb_hits;
+
+  printf("TLB:\n");
+  printf("%d.n_tlb_accesses \t%ld\n", core, stats->n_accesses);
+  printf("%d.dtlb_miss_rate \t%.2f\n", core,
+         stats->n_accesses ? 100.0 * n_dtlb_misses / stats->n_accesses : 0.0);
+  printf("%d.stlb_miss_rate \t%.2f\n", core,
+         n_dtlb_misses ? 100.0 * stats->n_walks / n_dtlb_misses : 0.0);
+  printf("%d.n_page_walks \t%ld\n", core, stats->n_walks);
+  printf("%d.n_walk_loads \t%ld\n", core, stats->n_walk_loads);
+  printf("%d.n_walk_misses \t%ld\n", core, stats->n_walk_misses);
+  printf("%d.B_walk_traffic \t%ld\n", core, stats->n_walk_misses * block_size);
 
 }
 
@@ -68,10 +104,32 @@ void print_cache_config(cache_t *cache) {
   printf("n_set \t\t\t%d\n",cache->n_set);
   printf("n_cache_line \t%d\n", cache->n_cache_line);
   printf("tag: %d, index: %d, offset: %d\n", cache->n_tag_bit, cache->n_index_bit, cache->n_offset_bit);
+  printf("Index Function: \t%s\n", index_fn_to_string(cache->index_fn));
+  if (cache->victim)
+    printf("victim_buffer \t\t%d lines\n", cache->n_victim);
+  if (cache->write_through_f || !cache->write_allocate_f)
+    printf("write_policy \t\t%s, %s\n", cache->write_through_f ? "write-through" : "write-back",
+           cache->write_allocate_f ? "allocate" : "no-allocate");
+  if (cache->wc)
+    printf("write_combining \t%d entries\n", cache->n_wc);
   printf("Coherence Protocol: \t%s\n", cache->protocol == NONE ? "none" : cache->protocol == VI ? "vi" : "msi");
   printf("lru_on_invalidate_f: \t%s\n", cache->lru_on_invalidate_f ? "true" : "false");
 }
 
+const char *index_fn_to_string(enum index_fn_t index_fn) {
+  switch(index_fn) {
+  case INDEX_MOD:
+    return "mod";
+  case INDEX_XOR:
+    return "xor";
+  case INDEX_PRIME:
+    return "prime";
+  case INDEX_SKEW:
+    return "skew";
+  }
+  return "-";
+}
+
 char state_to_char(enum state_t state) {
   switch(state) {
   case INVALID:
@@ -87,10 +145,107 @@ char state_to_char(enum state_t state) {
 }
 
 
+/* Captures what print_insn_info prints about an access, so it can be
+ * written to an event log and printed later */
+void make_log_event(simulator_t *sim, int core, char cmd, unsigned long addr, bool hit_f, log_event_t *event) {
+  cache_t *cache = sim->cache[core];
+  cache_line_t *line = &cache->lines[cache->last_set][cache->last_way];
+
+  memset(event, 0, sizeof(log_event_t));
+  event->addr = addr;
+  event->block_addr = get_cache_block_addr(cache, addr);
+  event->set = cache->last_set;
+  event->way = cache->last_way;
+  event->core = core;
+  event->cmd = cmd;
+  event->hit_f = hit_f;
+  event->state = line->state;
+  event->dirty_f = line->dirty_f;
+}
+
+void print_log_event(const log_event_t *event) {
+  printf("%d %c %lx --> {blk: %lx} %s ==> [set:%4d][way:%d](%c,%s)\n", event->core, event->cmd,
+	 (unsigned long)event->addr, (unsigned long)event->block_addr, event->hit_f ? " hit" : "miss",
+	 event->set, event->way, state_to_char(event->state), event->dirty_f ? "dirty" : "clean");
+}
+
 void print_insn_info(simulator_t *sim, int core, char cmd, unsigned long addr, bool hit_f) {
-  printf("%d %c %lx --> {blk: %lx} %s ==> [set:%4d][way:%d](%c,%s)\n", core, cmd,
-	 addr, get_cache_block_addr(sim->cache[core], addr), hit_f ? " hit" : "miss",
-	 print_set, print_way, state_to_char(sim->cache[core]->lines[print_set][print_way].state),
-	 sim->cache[core]->lines[print_set][print_way].dirty_f ? "dirty" : "clean");
+  log_event_t event;
+  make_log_event(sim, core, cmd, addr, hit_f, &event);
+  print_log_event(&event);
+}
+
+const char *sharing_kind_to_string(enum sharing_kind_t kind) {
+  switch(kind) {
+  case READ_SHARING:
+    return "read";
+  case TRUE_SHARING:
+    return "true";
+  case FALSE_SHARING:
+    return "false";
+  }
+  return "-";
+}
+
+void print_sharing_report(simulator_t *sim) {
+  sharing_tracker_t *tracker = sim->sharing;
+  sharing_block_t **top = malloc(sim->sharing_top_n * sizeof(sharing_block_t *));
+  int n_top = sharing_top_blocks(tracker, top, sim->sharing_top_n);
+
+  printf("    *** Coherence Attribution (top %d blocks) ***\n", sim->sharing_top_n);
+  if (sim->protocol == NONE) {
+    printf("no coherence protocol, nothing to attribute\n");
+  }
+  printf("%-10s %8s %8s %8s %10s  %-5s  %s\n", "block", "n_inval", "n_dgrade",
+         "n_cmiss", "B_traffic", "kind", "cores [read/write granules]");
+
+  for (int i = 0; i < n_top; i++) {
+    sharing_block_t *block = top[i];
+    printf("%-10lx %8ld %8ld %8ld %10ld  %-5s ", block->block_addr, block->n_invalidations,
+           block->n_downgrades, block->n_coherence_misses, block->B_traffic,
+           sharing_kind_to_string(sharing_classify(tracker, block)));
+    for (int core = 0; core < tracker->n_core; core++) {
+      if (block->core_mask & (1u << core)) {
+        printf(" %d[%llx/%llx]", core, (unsigned long long)block->read_mask[core],
+               (unsigned long long)block->write_mask[core]);
+      }
+    }
+    printf("\n");
+  }
+  printf("granule: %d B, blocks tracked: %ld\n", tracker->granule, tracker->blocks->n_used);
+
+  free(top);
 }
 
+/* Per socket traffic, with the socket's own bus (its cores' fills and
+ * writebacks) reported apart from what crossed between sockets.
+ */
+void print_socket_report(simulator_t *sim) {
+  topology_t *topology = sim->topology;
+  long B_cross_total = 0;
+
+  for (int s = 0; s < topology->n_socket; s++) {
+    socket_stats_t *stats = &topology->stats[s];
+    int first = s * topology->cores_per_socket;
+    int last = first + topology->cores_per_socket - 1;
+
+    long B_bus = 0;
+    for (int core = first; core <= last; core++) {
+      B_bus += sim->cache[core]->stats->B_total_traffic_wb;
+    }
+    B_cross_total += stats->B_cross_socket;
+
+    printf("    *** Results for Socket %d (cores %d-%d) ***\n", s, first, last);
+    printf("s%d.n_misses \t\t%ld\n", s, stats->n_misses);
+    printf("s%d.n_remote_misses \t%ld\n", s, stats->n_remote_misses);
+    printf("s%d.n_remote_snoops \t%ld\n", s, stats->n_remote_snoops);
+    printf("s%d.n_remote_snoop_hits \t%ld\n", s, stats->n_remote_snoop_hits);
+    printf("s%d.B_socket_bus \t%ld\n", s, B_bus);
+    printf("s%d.B_cross_socket \t%ld\n", s, stats->B_cross_socket);
+    printf("s%d.avg_miss_latency \t%.2f\n", s,
+           stats->n_misses ? stats->total_latency / (double)stats->n_misses : 0.0);
+  }
+
+  printf("    *** Cross-socket ***\n");
+  printf("x.B_cross_socket \t%ld\n", B_cross_total);
+}
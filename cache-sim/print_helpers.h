@@ -5,21 +5,33 @@
 #include "cache.h"
 #include "cache_stats.h"
 #include "simulator.h"
+#include "event_log.h"
 
 /* if you want verbose mode to work, you will need to call these 2 functions */
-void log_set(int set);
-void log_way(int way);
+void log_set(cache_t *cache, int set);
+void log_way(cache_t *cache, int way);
 
 void print_simulator_header(simulator_t *sim);
 
 void print_insn_info(simulator_t *sim, int core, char cmd, unsigned long address, bool hit_f);
+void make_log_event(simulator_t *sim, int core, char cmd, unsigned long address, bool hit_f, log_event_t *event);
+void print_log_event(const log_event_t *event);
 void print_trace_stats(cache_stats_t *stats);
 
 void print_stats(cache_stats_t *stats, int core);
+void print_victim_stats(cache_stats_t *stats, int core);
+void print_write_policy_stats(cache_stats_t *stats, int core);
+void print_tlb_stats(tlb_stats_t *stats, int core, int block_size);
 
 char state_to_char(enum state_t state);
+const char *index_fn_to_string(enum index_fn_t index_fn);
 
 void print_cache_config(cache_t *cache);
 
+const char *sharing_kind_to_string(enum sharing_kind_t kind);
+void print_sharing_report(simulator_t *sim);
+
+void print_socket_report(simulator_t *sim);
+
 
 #endif  // PRINT_HELPERS
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "profile.h"
+
+static const char *phase_names[N_PHASE] = { "parse", "tlb", "access", "snoop", "output", "report" };
+static const char *perf_names[N_PERF_COUNTER] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+
+#ifdef __linux__
+static int open_perf_counter(enum perf_counter_t counter) {
+    static const uint64_t configs[N_PERF_COUNTER] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[counter];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // this process, on any cpu, counting from now on
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+profiler_t *make_profiler(bool perf_f) {
+    profiler_t *profiler = calloc(1, sizeof(profiler_t));
+
+    profiler->perf_f = perf_f;
+    for (int i = 0; i < N_PERF_COUNTER; i++) {
+        profiler->perf_fd[i] = -1;
+#ifdef __linux__
+        if (perf_f) profiler->perf_fd[i] = open_perf_counter(i);
+#endif
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &profiler->start_time);
+    profiler->start_ticks = read_ticks();
+    profiler->mark = profiler->start_ticks;
+    profiler->phase = PHASE_PARSE;
+
+    return profiler;
+}
+
+void free_profiler(profiler_t *profiler) {
+    for (int i = 0; i < N_PERF_COUNTER; i++) {
+        if (profiler->perf_fd[i] >= 0) close(profiler->perf_fd[i]);
+    }
+    free(profiler);
+}
+
+/* Closes the current phase and prints where the run spent its time. */
+void print_profile(profiler_t *profiler, long total_insn) {
+    profile_switch(profiler, PHASE_REPORT);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double total_ns = (now.tv_sec - profiler->start_time.tv_sec) * 1e9 + (now.tv_nsec - profiler->start_time.tv_nsec);
+    uint64_t total_ticks = profiler->mark - profiler->start_ticks;
+    double ns_per_tick = total_ticks ? total_ns / total_ticks : 0;
+    if (total_insn == 0) total_insn = 1;
+
+    printf("    *** Profile ***\n");
+    printf("%-8s %14s %7s %12s %10s\n", "phase", "ticks", "%", "ns", "ns/insn");
+    for (int i = 0; i < N_PHASE; i++) {
+        printf("%-8s %14llu %6.2f%% %12.0f %10.2f\n", phase_names[i], (unsigned long long)profiler->ticks[i],
+               total_ticks ? 100.0 * profiler->ticks[i] / total_ticks : 0.0, profiler->ticks[i] * ns_per_tick,
+               profiler->ticks[i] * ns_per_tick / total_insn);
+    }
+    printf("%-8s %14llu %6.2f%% %12.0f %10.2f\n", "total", (unsigned long long)total_ticks, 100.0, total_ns,
+           total_ns / total_insn);
+
+    if (!profiler->perf_f)
+        return;
+
+    for (int i = 0; i < N_PERF_COUNTER; i++) {
+        long long count;
+        if (profiler->perf_fd[i] < 0 || read(profiler->perf_fd[i], &count, sizeof(count)) != sizeof(count)) {
+            printf("perf.%-14s unavailable\n", perf_names[i]);
+            continue;
+        }
+        printf("perf.%-14s %14lld %10.2f/insn\n", perf_names[i], count, count / (double)total_insn);
+    }
+}
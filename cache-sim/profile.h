@@ -0,0 +1,61 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// where p5 can be spending its time. update_stats is called from inside the
+// access kernels, so its cost is part of PHASE_ACCESS: timing it on its own
+// would cost more than it does.
+enum phase_t { PHASE_PARSE, PHASE_TLB, PHASE_ACCESS, PHASE_SNOOP, PHASE_OUTPUT, PHASE_REPORT, N_PHASE };
+
+enum perf_counter_t { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_BRANCH_MISSES, N_PERF_COUNTER };
+
+/*
+ * Phase timers for the simulator itself. The run is always in exactly one
+ * phase, and switching phase charges the time since the last switch to the
+ * phase being left, so every switch costs a single timestamp read.
+ */
+typedef struct {
+  uint64_t ticks[N_PHASE];
+  long n_switch[N_PHASE];  // times the phase was entered
+  enum phase_t phase;
+  uint64_t mark;
+
+  struct timespec start_time;  // to convert ticks into ns
+  uint64_t start_ticks;
+
+  // optional hardware counters over the whole run, -1 if unavailable
+  bool perf_f;
+  int perf_fd[N_PERF_COUNTER];
+} profiler_t;
+
+profiler_t *make_profiler(bool perf_f);
+void free_profiler(profiler_t *profiler);
+void print_profile(profiler_t *profiler, long total_insn);
+
+// rdtsc where there is one, nanoseconds otherwise
+static inline uint64_t read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+static inline void profile_switch(profiler_t *profiler, enum phase_t phase) {
+  uint64_t now = read_ticks();
+  profiler->ticks[profiler->phase] += now - profiler->mark;
+  profiler->n_switch[phase]++;
+  profiler->phase = phase;
+  profiler->mark = now;
+}
+
+#endif  // PROFILE
@@ -0,0 +1,156 @@
+#include <stdlib.h>
+
+#include "cache.h"
+#include "sharing.h"
+
+/* Tracks, for every block address touched by the trace, which parts of
+ * the block each core read and wrote and how much coherence activity the
+ * block caused. A block whose cores never touch each other's granules but
+ * still bounce the line back and forth is a false sharing candidate.
+ */
+sharing_tracker_t *make_sharing_tracker(int n_core, int block_size) {
+    sharing_tracker_t *tracker = malloc(sizeof(sharing_tracker_t));
+
+    tracker->n_core = n_core;
+    tracker->block_size = block_size;
+
+    // the per core masks are 64 bits wide, so large blocks get coarser granules
+    tracker->granule = block_size < WORD_SIZE ? block_size : WORD_SIZE;
+    if (block_size / tracker->granule > 64)
+        tracker->granule = block_size / 64;
+
+    tracker->blocks = make_block_table(sizeof(sharing_block_t));
+
+    return tracker;
+}
+
+void free_sharing_tracker(sharing_tracker_t *tracker) {
+    for (long i = 0; i < tracker->blocks->n_slot; i++) {
+        sharing_block_t *block = block_table_slot(tracker->blocks, i);
+        if (block != NULL) {
+            free(block->read_mask);
+            free(block->write_mask);
+        }
+    }
+    free_block_table(tracker->blocks);
+    free(tracker);
+}
+
+static sharing_block_t *get_block(sharing_tracker_t *tracker, unsigned long block_addr) {
+    bool added_f;
+    sharing_block_t *block = block_table_get(tracker->blocks, block_addr, &added_f);
+
+    if (added_f) {
+        block->block_addr = block_addr;
+        block->read_mask = calloc(tracker->n_core, sizeof(uint64_t));
+        block->write_mask = calloc(tracker->n_core, sizeof(uint64_t));
+    }
+
+    return block;
+}
+
+/* Called for every cpu access (LOAD or STORE). Records the granule the core
+ * touched and whether the access missed on a copy the core had previously
+ * lost to another core's invalidation (a coherence miss).
+ */
+void sharing_record_access(sharing_tracker_t *tracker, int core, unsigned long addr, enum action_t action,
+                           bool hit_f) {
+    unsigned long block_addr = addr - addr % tracker->block_size;
+    sharing_block_t *block = get_block(tracker, block_addr);
+
+    uint64_t bit = 1ULL << ((addr - block_addr) / tracker->granule);
+    if (action == STORE)
+        block->write_mask[core] |= bit;
+    else
+        block->read_mask[core] |= bit;
+
+    if (!hit_f && (block->lost_mask & (1u << core))) {
+        block->n_coherence_misses++;
+        block->B_traffic += tracker->block_size;
+    }
+    block->lost_mask &= ~(1u << core);
+}
+
+/* Called for every snoop that hit a valid copy in another core's cache.
+ * The requester's miss either invalidated that copy or, under MSI, forced
+ * a MODIFIED copy to be written back and downgraded to SHARED.
+ */
+void sharing_record_snoop(sharing_tracker_t *tracker, int requester, int core, unsigned long addr,
+                          bool invalidated_f, bool writeback_f) {
+    unsigned long block_addr = addr - addr % tracker->block_size;
+    sharing_block_t *block = get_block(tracker, block_addr);
+
+    if (invalidated_f) {
+        block->n_invalidations++;
+        block->lost_mask |= 1u << core;
+    } else if (writeback_f) {
+        block->n_downgrades++;
+    } else {
+        return;
+    }
+
+    if (writeback_f) {
+        block->n_writebacks++;
+        block->B_traffic += tracker->block_size;
+    }
+
+    block->core_mask |= (1u << requester) | (1u << core);
+}
+
+/* A block is a false sharing candidate when no granule written by one core
+ * was touched by any other core, i.e. the cores only ever collide on the
+ * line, never on the data. Blocks nobody wrote only bounce under VI, where
+ * a load miss invalidates too.
+ */
+enum sharing_kind_t sharing_classify(sharing_tracker_t *tracker, sharing_block_t *block) {
+    bool written_f = false;
+
+    for (int a = 0; a < tracker->n_core; a++) {
+        if (!(block->core_mask & (1u << a)))
+            continue;
+        if (block->write_mask[a])
+            written_f = true;
+        for (int b = 0; b < tracker->n_core; b++) {
+            if (a != b && (block->core_mask & (1u << b)) &&
+                (block->write_mask[a] & (block->read_mask[b] | block->write_mask[b])))
+                return TRUE_SHARING;
+        }
+    }
+    return written_f ? FALSE_SHARING : READ_SHARING;
+}
+
+static int compare_cost(const void *a, const void *b) {
+    const sharing_block_t *x = *(sharing_block_t *const *)a;
+    const sharing_block_t *y = *(sharing_block_t *const *)b;
+
+    if (x->B_traffic != y->B_traffic)
+        return x->B_traffic < y->B_traffic ? 1 : -1;
+    if (x->n_invalidations != y->n_invalidations)
+        return x->n_invalidations < y->n_invalidations ? 1 : -1;
+    return x->block_addr < y->block_addr ? -1 : x->block_addr > y->block_addr;
+}
+
+/* Fills out with (up to) the n blocks that caused the most coherence
+ * traffic, most costly first. Returns how many were written.
+ */
+int sharing_top_blocks(sharing_tracker_t *tracker, sharing_block_t **out, int n) {
+    sharing_block_t **ranked = malloc(tracker->blocks->n_used * sizeof(sharing_block_t *));
+    long n_ranked = 0;
+
+    for (long i = 0; i < tracker->blocks->n_slot; i++) {
+        sharing_block_t *block = block_table_slot(tracker->blocks, i);
+        if (block != NULL && (block->n_invalidations > 0 || block->n_downgrades > 0)) {
+            ranked[n_ranked++] = block;
+        }
+    }
+
+    qsort(ranked, n_ranked, sizeof(sharing_block_t *), compare_cost);
+
+    int n_out = n_ranked < n ? n_ranked : n;
+    for (int i = 0; i < n_out; i++) {
+        out[i] = ranked[i];
+    }
+
+    free(ranked);
+    return n_out;
+}
@@ -0,0 +1,50 @@
+#ifndef __SHARING_H
+#define __SHARING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "block_table.h"
+#include "cache_stats.h"
+
+// how the cores involved with a block use its data
+enum sharing_kind_t { READ_SHARING, TRUE_SHARING, FALSE_SHARING };
+
+// coherence attribution for a single block address
+typedef struct {
+  unsigned long block_addr;
+
+  long n_invalidations;     // copies invalidated by another core's miss
+  long n_downgrades;        // MODIFIED copies forced to SHARED (MSI only)
+  long n_coherence_misses;  // misses on a copy this core lost to an invalidation
+  long n_writebacks;        // writebacks forced by a snoop
+
+  long B_traffic;  // bus traffic caused by coherence on this block
+
+  unsigned int core_mask;  // cores involved in invalidations / downgrades
+  unsigned int lost_mask;  // cores whose copy was invalidated and not yet refetched
+
+  // one bit per granule of the block, per core
+  uint64_t *read_mask;
+  uint64_t *write_mask;
+} sharing_block_t;
+
+typedef struct {
+  int n_core;
+  int block_size;
+  int granule;  // bytes per bit of read_mask / write_mask
+
+  block_table_t *blocks;  // of sharing_block_t
+} sharing_tracker_t;
+
+sharing_tracker_t *make_sharing_tracker(int n_core, int block_size);
+void free_sharing_tracker(sharing_tracker_t *tracker);
+
+void sharing_record_access(sharing_tracker_t *tracker, int core, unsigned long addr, enum action_t action,
+                           bool hit_f);
+void sharing_record_snoop(sharing_tracker_t *tracker, int requester, int core, unsigned long addr,
+                          bool invalidated_f, bool writeback_f);
+
+enum sharing_kind_t sharing_classify(sharing_tracker_t *tracker, sharing_block_t *block);
+int sharing_top_blocks(sharing_tracker_t *tracker, sharing_block_t **out, int n);
+
+#endif  // SHARING
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -5,41 +6,309 @@
 
 #include "simulator.h"
 #include "print_helpers.h"
+#include "memo.h"
+
+static void print_results(simulator_t *sim, const memo_run_t *run);
+
+// charges the time since the last switch to the phase being left
+#define PROFILE(sim, phase) do { if ((sim)->profiler) profile_switch((sim)->profiler, phase); } while (0)
 
 simulator_t *make_simulator() {
     simulator_t *sim = malloc(sizeof(simulator_t));
 
-    sim->trace = "route.1t.short.txt";
+    sim->trace = NULL;
+    sim->timed_f = false;
     sim->verbose_f = false;
 
+    sim->event_log_path = NULL;
+    sim->event_log = NULL;
+
     sim->limit_insn_f = false;
     sim->insn_limit = 0;
 
+    sim->converge_f = false;
+    sim->converge_eps = 0;
+    sim->converge_window = 0;
+    sim->converge_n_window = 0;
+    sim->converge_last_rate = -1;
+    sim->converge_n_stable = 0;
+
     sim->n_core = 1;
+    sim->cache = NULL;
     sim->protocol = NONE;
 
+    sim->n_socket = 1;
+    sim->local_latency = DEFAULT_LOCAL_LATENCY;
+    sim->remote_latency = DEFAULT_REMOTE_LATENCY;
+    sim->topology = NULL;
+
+    sim->capacity = 0;
+    sim->block_size = 0;
+    sim->assoc = 0;
+    sim->index_fn = INDEX_MOD;
+    sim->n_victim = 0;
+    sim->write_through_f = false;
+    sim->write_allocate_f = true;
+    sim->n_write_combining = 0;
+    sim->page_size = 0;
+    sim->mmu = NULL;
+    sim->tag_index_assoc = DEFAULT_TAG_INDEX_ASSOC;
+
     sim->lru_on_invalidate_f = false;
 
+    sim->sharing_f = false;
+    sim->sharing_top_n = 0;
+    sim->sharing = NULL;
+
+    sim->profile_f = false;
+    sim->profile_perf_f = false;
+    sim->profiler = NULL;
+
+    sim->memo_dir = NULL;
+
     return sim;
 }
 
+/*
+ * Creates one cache per core from the configuration. Must be called
+ * once all the configuration fields are set and before any access.
+ */
+void init_simulator(simulator_t *sim) {
+    sim->cache = malloc(sim->n_core * sizeof(cache_t*));
+    for (int i = 0; i < sim->n_core; i++){
+        sim->cache[i] = make_cache(sim->capacity, sim->block_size, sim->assoc,
+                sim->protocol, sim->lru_on_invalidate_f);
+        set_cache_index_fn(sim->cache[i], sim->index_fn);
+        if (sim->assoc > sim->tag_index_assoc) enable_tag_index(sim->cache[i]);
+        if (sim->n_victim > 0) enable_victim_buffer(sim->cache[i], sim->n_victim);
+        set_write_policy(sim->cache[i], sim->write_through_f, sim->write_allocate_f);
+        if (sim->n_write_combining > 0) enable_write_combining(sim->cache[i], sim->n_write_combining);
+    }
+
+    if (sim->page_size > 0) {
+        sim->mmu = malloc(sim->n_core * sizeof(mmu_t*));
+        for (int i = 0; i < sim->n_core; i++) {
+            sim->mmu[i] = make_mmu(sim->page_size);
+        }
+    }
+
+    if (sim->n_socket > 1) {
+        sim->topology = make_topology(sim->n_core, sim->n_socket, sim->block_size,
+                sim->local_latency, sim->remote_latency);
+    }
+
+    if (sim->sharing_f) {
+        sim->sharing = make_sharing_tracker(sim->n_core, sim->block_size);
+    }
+
+    if (sim->event_log_path) {
+        sim->event_log = open_event_log(sim->event_log_path);
+        if (sim->event_log == NULL) {
+            printf("Cannot open event log \'%s\'\n", sim->event_log_path);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void free_simulator(simulator_t *sim) {
+    if (sim->cache) {
+        for (int i = 0; i < sim->n_core; i++) {
+            free_cache(sim->cache[i]);
+        }
+        free(sim->cache);
+    }
+    if (sim->sharing) free_sharing_tracker(sim->sharing);
+    if (sim->topology) free_topology(sim->topology);
+    if (sim->mmu) {
+        for (int i = 0; i < sim->n_core; i++) {
+            free_mmu(sim->mmu[i]);
+        }
+        free(sim->mmu);
+    }
+    if (sim->event_log) close_event_log(sim->event_log);
+    if (sim->profiler) free_profiler(sim->profiler);
+    free(sim);
+}
+
+/*
+ * Delivers the snoop for core's miss to another core's cache.
+ * Returns true if it hit, and sets writeback_f if it forced a writeback.
+ */
+static bool snoop_core(simulator_t *sim, int core, int i, unsigned long address, enum action_t snoop,
+                       bool *writeback_f) {
+    long n_writebacks = sim->cache[i]->stats->n_writebacks;
+    bool snoop_hit_f = access_cache(sim->cache[i], address, snoop);
+    *writeback_f = sim->cache[i]->stats->n_writebacks > n_writebacks;
+
+    // VI invalidates on any snoop hit, MSI only on a ST_MISS
+    if (sim->sharing && sim->protocol != NONE && snoop_hit_f) {
+        sharing_record_snoop(sim->sharing, core, i, address,
+                sim->protocol == VI || snoop == ST_MISS, *writeback_f);
+    }
+
+    return snoop_hit_f;
+}
+
+/*
+ * With more than one socket, a miss consults the directory and is sent to
+ * every other socket that may hold the block. Data comes across only when
+ * a remote copy had to be written back, otherwise memory supplies it.
+ */
+static void snoop_remote_sockets(simulator_t *sim, int core, unsigned long address, enum action_t snoop) {
+    topology_t *topology = sim->topology;
+    int socket = socket_of(topology, core);
+    socket_stats_t *stats = &topology->stats[socket];
+
+    stats->n_misses++;
+    if (sim->protocol == NONE) { // no coherence, nothing to forward
+        stats->total_latency += topology->local_latency;
+        return;
+    }
+
+    unsigned int remote = directory_remote_sockets(topology, socket, address);
+    if (remote == 0) {
+        stats->total_latency += topology->local_latency;
+    } else {
+        bool data_f = false;
+
+        stats->n_remote_misses++;
+        stats->total_latency += topology->remote_latency;
+
+        for (int s = 0; s < topology->n_socket; s++) {
+            if (!(remote & (1u << s)))
+                continue;
+
+            stats->B_cross_socket += CONTROL_MSG_SIZE;
+            topology->stats[s].n_remote_snoops++;
+
+            bool snoop_hit_f = false;
+            for (int i = s * topology->cores_per_socket; i < (s + 1) * topology->cores_per_socket; i++) {
+                bool writeback_f;
+                snoop_hit_f |= snoop_core(sim, core, i, address, snoop, &writeback_f);
+                data_f |= writeback_f;
+            }
+            if (snoop_hit_f) topology->stats[s].n_remote_snoop_hits++;
+        }
+
+        if (data_f) stats->B_cross_socket += sim->block_size;
+    }
+
+    // VI invalidates on any miss, MSI only on a ST_MISS
+    directory_update(topology, socket, address, sim->protocol == VI || snoop == ST_MISS);
+}
+
+/*
+ * Accesses the core's cache. A miss is broadcast on the bus so that the
+ * other cores can snoop it. Returns true if the access hit.
+ */
+static bool access_and_snoop(simulator_t *sim, int core, unsigned long address, enum action_t action) {
+    // access the cache
+    PROFILE(sim, PHASE_ACCESS);
+    bool hit_f = access_cache(sim->cache[core], address, action);
+
+    if (sim->sharing) sharing_record_access(sim->sharing, core, address, action, hit_f);
+
+    // misses go on the bus
+    // (LOAD --> LD_MISS, STORE --> ST_MISS)
+    if (!hit_f) { 
+        PROFILE(sim, PHASE_SNOOP);
+        enum action_t snoop = (action == LOAD) ? LD_MISS : ST_MISS;
+        for (int i = 0; i < sim->n_core; i++){ // 1 core? does nothing
+            // with sockets, only the cores on the same bus see it directly
+            if (i != core && (sim->topology == NULL ||
+                        socket_of(sim->topology, i) == socket_of(sim->topology, core))) {
+                bool writeback_f;
+                snoop_core(sim, core, i, address, snoop, &writeback_f);
+            }  
+        }
+        if (sim->topology) snoop_remote_sockets(sim, core, address, snoop);
+    }
+
+    return hit_f;
+}
+
+/*
+ * Simulates a single cpu access (LOAD or STORE) by the given core.
+ * With a TLB, a translation that misses in both levels first walks the
+ * page table, every level of which is a load through the core's cache.
+ * Returns true if the access hit in the core's cache.
+ */
+bool simulate_access(simulator_t *sim, int core, unsigned long address, enum action_t action) {
+    if (sim->mmu) {
+        mmu_t *mmu = sim->mmu[core];
+        unsigned long walk_addrs[MAX_WALK_LEVELS];
+        PROFILE(sim, PHASE_TLB);
+        int n_walk = mmu_translate(mmu, address, walk_addrs);
+
+        // walk loads are reported with the TLB stats, so the core's cpu
+        // access counters keep describing the trace alone
+        cache_stats_t *stats = sim->cache[core]->stats;
+        long n_cpu_accesses = stats->n_cpu_accesses;
+        long n_hits = stats->n_hits;
+        for (int i = 0; i < n_walk; i++) {
+            if (!access_and_snoop(sim, core, walk_addrs[i], LOAD))
+                mmu->stats.n_walk_misses++;
+        }
+        stats->n_cpu_accesses = n_cpu_accesses;
+        stats->n_hits = n_hits;
+    }
+
+    return access_and_snoop(sim, core, address, action);
+}
+
+/*
+ * Simulates one trace record and prints or logs it if asked to.
+ */
+static void simulate_record(simulator_t *sim, int core, char cmd, unsigned long address) {
+    enum action_t action = (cmd == 'r') ? LOAD : STORE;
+
+    bool hit_f = simulate_access(sim, core, address, action);
+
+    // prints the insn
+    PROFILE(sim, PHASE_OUTPUT);
+    if (sim->verbose_f) print_insn_info(sim, core, cmd, address, hit_f);
+    if (sim->event_log) {
+        log_event_t event;
+        make_log_event(sim, core, cmd, address, hit_f, &event);
+        log_event(sim->event_log, &event);
+    }
+}
+
+/*
+ * At the end of every window, checks whether the hit rate over all cores
+ * has settled. Returns true once it stayed within converge_eps for
+ * converge_n_window windows in a row.
+ */
+static bool converged(simulator_t *sim, memo_run_t *run) {
+    if (!sim->converge_f || run->total_insn % sim->converge_window != 0)
+        return false;
+
+    long n_hits = 0;
+    long n_accesses = 0;
+    for (int i = 0; i < sim->n_core; i++) {
+        n_hits += sim->cache[i]->stats->n_hits;
+        n_accesses += sim->cache[i]->stats->n_cpu_accesses;
+    }
+    double rate = 100.0 * n_hits / n_accesses;
+
+    if (sim->converge_last_rate >= 0 && fabs(rate - sim->converge_last_rate) <= sim->converge_eps)
+        sim->converge_n_stable++;
+    else
+        sim->converge_n_stable = 0;
+    sim->converge_last_rate = rate;
+
+    run->converged_f = sim->converge_n_stable >= sim->converge_n_window;
+    return run->converged_f;
+}
+
 /*
  * Goes through the trace line by line (i.e., instruction by
  * instruction) and simulates the program being executed on a
  * multicore processor.
  */
-void process_trace(simulator_t *sim) {
-    int i;
+static void simulate_trace_in_order(simulator_t *sim, const char *path, memo_run_t *run) {
     char *line = NULL;
-    // Program Stats
-    long total_insn = 0;
 
-    printf("Processing trace...\n");
-    printf("%d %d\n", sim->n_core, sim->protocol);
-
-    char *path = malloc(strlen(sim->trace) + 7);
-    strncpy(path, "trace/", 7);
-    strcat(path, sim->trace);
     FILE *trace = fopen(path, "r");
     if (trace == NULL) {
         printf("File \'%s\' not found\n", sim->trace);
@@ -49,9 +318,8 @@ void process_trace(simulator_t *sim) {
     size_t read;
 
     while ((read = getline(&line, &len, trace)) != -1) {
-        if (sim->limit_insn_f && total_insn == sim->insn_limit) {
-            printf("Reached insn limit of %d. Ending Simulation...\n",
-                    sim->insn_limit);
+        if (sim->limit_insn_f && run->total_insn == sim->insn_limit) {
+            run->limit_reached_f = true;
             break;
         }
 
@@ -61,38 +329,134 @@ void process_trace(simulator_t *sim) {
             exit(EXIT_FAILURE);
         }
 
-        enum action_t action = (line[2] == 'r') ? LOAD : STORE;
         unsigned long address = strtol(&line[4], NULL, 16);
 
-        total_insn++;
+        run->total_insn++;
 
-        // access the cache
-        bool hit_f = access_cache(sim->cache[core], address, action);
+        simulate_record(sim, core, line[2], address);
+        if (converged(sim, run)) break;
+        PROFILE(sim, PHASE_PARSE);
+    }
 
-        // prints the insn
-        if (sim->verbose_f) print_insn_info(sim, core, line[2], address, hit_f);
+    fclose(trace);
+    if (line) free(line);
+}
 
-        // misses go on the bus
-        // (LOAD --> LD_MISS, STORE --> ST_MISS)
-        if (!hit_f) { 
-            for (i = 0; i < sim->n_core; i++){ // 1 core? does nothing
-                if (i != core) {
-                    access_cache(sim->cache[i], address,
-                            (action == LOAD) ? LD_MISS : ST_MISS);
-                }  
-            }
+/*
+ * Loads every core's records, from the one trace or from a trace per
+ * core, and simulates them in time order.
+ */
+static void simulate_trace_by_time(simulator_t *sim, const char *path, bool per_core_f, memo_run_t *run) {
+    int bad_core;
+    trace_stream_t *streams = load_trace_streams(path, sim->n_core, per_core_f, &bad_core);
+    if (streams == NULL) {
+        if (per_core_f) {
+            printf("File \'%s\' not found for core %d\n", sim->trace, bad_core);
+        } else if (bad_core < 0) {
+            printf("File \'%s\' not found\n", sim->trace);
+        } else {
+            printf("ERROR: this trace requires atleast %d cores!\n", bad_core + 1);
         }
+        exit(EXIT_FAILURE);
     }
 
-    fclose(trace);
-    if (line) free(line);
+    trace_merger_t *merger = make_trace_merger(streams, sim->n_core);
+    int core;
+    trace_record_t *record;
+
+    while (next_trace_record(merger, &core, &record)) {
+        if (sim->limit_insn_f && run->total_insn == sim->insn_limit) {
+            run->limit_reached_f = true;
+            break;
+        }
+
+        run->total_insn++;
+
+        simulate_record(sim, core, record->cmd, record->addr);
+        if (converged(sim, run)) break;
+        PROFILE(sim, PHASE_PARSE);
+    }
+
+    free_trace_merger(merger);
+    free_trace_streams(streams, sim->n_core);
+}
+
+/*
+ * Simulates the trace, or prints the stored results of an identical run.
+ */
+void process_trace(simulator_t *sim) {
+    // Program Stats
+    memo_run_t run = { 0, false, false };
 
-    printf("Processed %ld lines.\n", total_insn);
+    // everything up to the first access counts as parsing
+    if (sim->profile_f) sim->profiler = make_profiler(sim->profile_perf_f);
+
+    printf("Processing trace...\n");
+    printf("%d %d\n", sim->n_core, sim->protocol);
+
+    char *path = malloc(strlen(sim->trace) + 7);
+    strncpy(path, "trace/", 7);
+    strcat(path, sim->trace);
+    bool per_core_f = strstr(sim->trace, "%d") != NULL;
+    if (per_core_f && !is_per_core_pattern(sim->trace)) {
+        printf("Trace name \'%s\' may only contain a single %%d\n", sim->trace);
+        exit(EXIT_FAILURE);
+    }
+
+    // only the statistics are memoized, so runs printing anything else,
+    // including the profile of the simulation, are simulated. A trace per
+    // core has no single file to key the results by.
+    bool memo_f = sim->memo_dir && !sim->verbose_f && !sim->event_log && !sim->sharing && !sim->topology &&
+                  !sim->mmu && !sim->profile_f && !per_core_f;
+    if (memo_f && memo_load(sim, path, &run)) {
+        free(path);
+        print_results(sim, &run);
+        return;
+    }
+
+    if (sim->timed_f || per_core_f)
+        simulate_trace_by_time(sim, path, per_core_f, &run);
+    else
+        simulate_trace_in_order(sim, path, &run);
+
+    for (int i = 0; i < sim->n_core; i++) {
+        drain_write_combining(sim->cache[i]);
+    }
+
+    if (memo_f) memo_store(sim, path, &run);
+    free(path);
+
+    print_results(sim, &run);
+}
+
+/*
+ * Prints how the run ended and every core's statistics, whether they were
+ * just simulated or loaded from the memo store.
+ */
+static void print_results(simulator_t *sim, const memo_run_t *run) {
+    PROFILE(sim, PHASE_REPORT);
+
+    if (run->limit_reached_f)
+        printf("Reached insn limit of %d. Ending Simulation...\n", sim->insn_limit);
+    if (run->converged_f)
+        printf("Hit rate converged after %ld insns (within %g%% over %d windows of %ld). "
+               "Ending Simulation...\n", run->total_insn, sim->converge_eps, sim->converge_n_window,
+               sim->converge_window);
+
+    printf("Processed %ld lines.\n", run->total_insn);
 
     // compute cache statistics
-    for (i = 0; i < sim->n_core; i++){
+    for (int i = 0; i < sim->n_core; i++){
         calculate_stat_rates(sim->cache[i]->stats, sim->cache[i]->block_size);  
         printf("    *** Results for Core %d ***\n", i);
         print_stats(sim->cache[i]->stats, i);
+        if (sim->n_victim > 0) print_victim_stats(sim->cache[i]->stats, i);
+        if (sim->write_through_f || !sim->write_allocate_f || sim->n_write_combining > 0)
+            print_write_policy_stats(sim->cache[i]->stats, i);
+        if (sim->mmu) print_tlb_stats(&sim->mmu[i]->stats, i, sim->block_size);
     }
+
+    if (sim->topology) print_socket_report(sim);
+    if (sim->sharing) print_sharing_report(sim);
+    if (sim->profiler) print_profile(sim->profiler, run->total_insn);
 }
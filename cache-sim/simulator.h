@@ -4,28 +4,103 @@
 #include <stdbool.h>
 #include "cache.h"
 #include "cache_stats.h"
+#include "sharing.h"
+#include "event_log.h"
+#include "topology.h"
+#include "tlb.h"
+#include "trace.h"
+#include "profile.h"
+
+// above this associativity, scanning the ways costs more than hashing the tag
+#define DEFAULT_TAG_INDEX_ASSOC 16
 
 typedef struct {
+  // a trace name with a %d names one trace per core, which implies timed_f
   char* trace;
 
+  // merge the cores' records by their time field instead of taking them
+  // in file order
+  bool timed_f;
+
   // print per access information, by default off
   bool verbose_f;
 
+  // optionally write the per access information to a binary log instead,
+  // which p5_log turns back into the verbose printout
+  char* event_log_path;
+  event_log_t *event_log;
+
   // optionally limit the simulation to the first N insns
   // do not break this functionality when you complete the code!
   bool limit_insn_f;
   int insn_limit;
 
+  // optionally stop once the hit rate over all cores moved by at most
+  // converge_eps percentage points in each of converge_n_window
+  // consecutive windows of converge_window insns
+  bool converge_f;
+  double converge_eps;
+  long converge_window;
+  int converge_n_window;
+  double converge_last_rate;  // at the end of the previous window
+  int converge_n_stable;      // consecutive windows within converge_eps
+
   bool lru_on_invalidate_f; // whether to change the LRU bit when you invalidate a line  
 	
   int n_core;
   cache_t** cache;
 
+  // configuration shared by every core's cache
+  int capacity;    // in Bytes
+  int block_size;  // in Bytes
+  int assoc;
+  enum index_fn_t index_fn;
+  int n_victim;  // lines in the victim buffer behind each cache, 0 for none
+
+  // write-back, write-allocate unless set, optionally with an n_write_combining
+  // entry write-combining buffer per cache
+  bool write_through_f;
+  bool write_allocate_f;
+  int n_write_combining;
+
+  // translate every access through a per core TLB hierarchy for pages
+  // of this size, whose page walks load through the caches. 0 for none.
+  long page_size;
+  mmu_t** mmu;
+
+  // caches more associative than this get a tag -> way index
+  int tag_index_assoc;
+
   enum protocol_t protocol;
+
+  // cores are split evenly into n_socket sockets, each with its own
+  // snooping bus, joined by a directory. 1 socket is a single shared bus.
+  int n_socket;
+  int local_latency;   // in cycles
+  int remote_latency;  // in cycles
+  topology_t *topology;
+
+  // attribute coherence traffic to block addresses and report the
+  // top sharing_top_n most costly blocks at the end of the run
+  bool sharing_f;
+  int sharing_top_n;
+  sharing_tracker_t *sharing;
+
+  // time the phases of the run, optionally with hardware counters
+  bool profile_f;
+  bool profile_perf_f;
+  profiler_t *profiler;
+
+  // directory of memoized results, NULL to always simulate. Options
+  // that change the statistics must also be added to memo_key.
+  char* memo_dir;
   
 } simulator_t;
 
 simulator_t* make_simulator();
+void init_simulator(simulator_t *sim);
+void free_simulator(simulator_t *sim);
+bool simulate_access(simulator_t *sim, int core, unsigned long address, enum action_t action);
 void process_trace(simulator_t *sim);
 
 #endif  // SIMULATOR
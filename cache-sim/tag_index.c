@@ -0,0 +1,77 @@
+#include <stdlib.h>
+
+#include "tag_index.h"
+
+/* Creates the index for a cache whose lines all start out with
+ * initial_tag, i.e. every way of every set sits on the same chain.
+ */
+tag_index_t *make_tag_index(int n_set, int assoc, unsigned long initial_tag) {
+    tag_index_t *index = malloc(sizeof(tag_index_t));
+
+    // at least 2 buckets per way keeps the chains short
+    index->assoc = assoc;
+    index->bucket_bits = 1;
+    while ((1 << index->bucket_bits) < 2 * assoc)
+        index->bucket_bits++;
+    index->n_bucket = 1 << index->bucket_bits;
+
+    index->head = malloc((long)n_set * index->n_bucket * sizeof(int));
+    index->next = malloc((long)n_set * assoc * sizeof(int));
+    index->prev = malloc((long)n_set * assoc * sizeof(int));
+
+    int bucket = tag_index_bucket(index, initial_tag);
+    for (long set = 0; set < n_set; set++) {
+        for (int b = 0; b < index->n_bucket; b++) {
+            index->head[set * index->n_bucket + b] = (b == bucket) ? 0 : NO_WAY;
+        }
+        for (int way = 0; way < assoc; way++) {
+            index->next[set * assoc + way] = (way + 1 < assoc) ? way + 1 : NO_WAY;
+            index->prev[set * assoc + way] = way - 1;  // NO_WAY for way 0
+        }
+    }
+
+    return index;
+}
+
+void free_tag_index(tag_index_t *index) {
+    free(index->head);
+    free(index->next);
+    free(index->prev);
+    free(index);
+}
+
+void tag_index_move(tag_index_t *index, int set, int way, unsigned long old_tag, unsigned long new_tag) {
+    int *head = &index->head[(long)set * index->n_bucket];
+    int *next = &index->next[(long)set * index->assoc];
+    int *prev = &index->prev[(long)set * index->assoc];
+
+    int old_bucket = tag_index_bucket(index, old_tag);
+    int new_bucket = tag_index_bucket(index, new_tag);
+    if (old_bucket == new_bucket)
+        return;
+
+    // unlink from the old chain
+    if (prev[way] == NO_WAY)
+        head[old_bucket] = next[way];
+    else
+        next[prev[way]] = next[way];
+    if (next[way] != NO_WAY)
+        prev[next[way]] = prev[way];
+
+    // link into the new chain, keeping it sorted by way
+    int before = NO_WAY;
+    int after = head[new_bucket];
+    while (after != NO_WAY && after < way) {
+        before = after;
+        after = next[after];
+    }
+
+    prev[way] = before;
+    next[way] = after;
+    if (before == NO_WAY)
+        head[new_bucket] = way;
+    else
+        next[before] = way;
+    if (after != NO_WAY)
+        prev[after] = way;
+}
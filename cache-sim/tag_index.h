@@ -0,0 +1,45 @@
+#ifndef __TAG_INDEX_H
+#define __TAG_INDEX_H
+
+#define NO_WAY -1
+
+/*
+ * Per set hash index from tag to way, so that finding a tag in a highly
+ * associative set does not have to scan every way.
+ *
+ * Each set has n_bucket chains. A way is on the chain its current tag
+ * hashes to, and chains are kept sorted by way, so walking a chain and
+ * skipping the other tags on it visits the ways holding a tag in the same
+ * order a linear scan would.
+ */
+typedef struct {
+  int assoc;
+  int n_bucket;  // per set, power of 2
+  int bucket_bits;
+
+  int *head;  // [set * n_bucket + bucket], first way on the chain
+  int *next;  // [set * assoc + way]
+  int *prev;  // [set * assoc + way]
+} tag_index_t;
+
+tag_index_t *make_tag_index(int n_set, int assoc, unsigned long initial_tag);
+void free_tag_index(tag_index_t *index);
+
+/* Must be called whenever the tag of a line changes. */
+void tag_index_move(tag_index_t *index, int set, int way, unsigned long old_tag, unsigned long new_tag);
+
+static inline int tag_index_bucket(tag_index_t *index, unsigned long tag) {
+  return (int)(((tag * 0x9E3779B97F4A7C15UL) >> (64 - index->bucket_bits)) & (index->n_bucket - 1));
+}
+
+/* First way on the chain tag belongs to, or NO_WAY. */
+static inline int tag_index_first(tag_index_t *index, int set, unsigned long tag) {
+  return index->head[set * index->n_bucket + tag_index_bucket(index, tag)];
+}
+
+/* Next way on the same chain, or NO_WAY. */
+static inline int tag_index_next(tag_index_t *index, int set, int way) {
+  return index->next[set * index->assoc + way];
+}
+
+#endif  // TAG_INDEX
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+
+#include "tlb.h"
+
+#define PAGE_4K (4L << 10)
+#define PAGE_2M (2L << 20)
+#define PAGE_1G (1L << 30)
+
+bool is_valid_page_size(long page_size) {
+    return page_size == PAGE_4K || page_size == PAGE_2M || page_size == PAGE_1G;
+}
+
+static tlb_t *make_tlb(int n_entry, int assoc) {
+    tlb_t *tlb = malloc(sizeof(tlb_t));
+
+    tlb->n_entry = n_entry;
+    tlb->assoc = assoc;
+    tlb->n_set = n_entry / assoc;
+    tlb->entries = calloc(n_entry, sizeof(tlb_entry_t));  // all invalid
+    tlb->use_clock = 0;
+
+    return tlb;
+}
+
+static void free_tlb(tlb_t *tlb) {
+    free(tlb->entries);
+    free(tlb);
+}
+
+/* Sized after a recent x86 core, which has fewer entries for larger pages. */
+mmu_t *make_mmu(long page_size) {
+    mmu_t *mmu = malloc(sizeof(mmu_t));
+
+    mmu->page_size = page_size;
+    mmu->page_bits = 0;
+    while ((1L << mmu->page_bits) < page_size)
+        mmu->page_bits++;
+
+    if (page_size == PAGE_4K) {
+        mmu->dtlb = make_tlb(64, 4);
+        mmu->stlb = make_tlb(1536, 12);
+    } else if (page_size == PAGE_2M) {
+        mmu->dtlb = make_tlb(32, 4);
+        mmu->stlb = make_tlb(1536, 12);
+    } else {
+        mmu->dtlb = make_tlb(4, 4);
+        mmu->stlb = make_tlb(16, 4);
+    }
+
+    mmu->stats = (tlb_stats_t){ 0 };
+
+    return mmu;
+}
+
+void free_mmu(mmu_t *mmu) {
+    free_tlb(mmu->dtlb);
+    free_tlb(mmu->stlb);
+    free(mmu);
+}
+
+static bool tlb_lookup(tlb_t *tlb, unsigned long vpn) {
+    tlb_entry_t *set = &tlb->entries[(vpn % tlb->n_set) * tlb->assoc];
+    tlb->use_clock++;
+
+    for (int i = 0; i < tlb->assoc; i++) {
+        if (set[i].valid_f && set[i].vpn == vpn) {
+            set[i].last_use = tlb->use_clock;
+            return true;
+        }
+    }
+    return false;
+}
+
+// replaces an invalid entry if there is one, else the least recently used
+static void tlb_insert(tlb_t *tlb, unsigned long vpn) {
+    tlb_entry_t *set = &tlb->entries[(vpn % tlb->n_set) * tlb->assoc];
+    tlb_entry_t *victim = &set[0];
+
+    for (int i = 0; i < tlb->assoc; i++) {
+        if (!set[i].valid_f) {
+            victim = &set[i];
+            break;
+        }
+        if (set[i].last_use < victim->last_use)
+            victim = &set[i];
+    }
+
+    victim->vpn = vpn;
+    victim->valid_f = true;
+    victim->last_use = tlb->use_clock;
+}
+
+/* Each level of the table translates 9 bits of the address, and a large
+ * page simply ends the walk early: 4 loads for 4K, 3 for 2M, 2 for 1G.
+ * Every level's entries sit in their own region above PAGE_TABLE_BASE.
+ */
+int mmu_translate(mmu_t *mmu, unsigned long addr, unsigned long *walk_addrs) {
+    unsigned long vpn = addr >> mmu->page_bits;
+    mmu->stats.n_accesses++;
+
+    if (tlb_lookup(mmu->dtlb, vpn)) {
+        mmu->stats.n_dtlb_hits++;
+        return 0;
+    }
+
+    if (tlb_lookup(mmu->stlb, vpn)) {
+        mmu->stats.n_stlb_hits++;
+        tlb_insert(mmu->dtlb, vpn);
+        return 0;
+    }
+
+    int n_walk = 0;
+    for (int level = 0, shift = 39; shift >= mmu->page_bits; level++, shift -= 9) {
+        walk_addrs[n_walk++] = PAGE_TABLE_BASE + ((unsigned long)level << 36) + (addr >> shift) * PTE_SIZE;
+    }
+    mmu->stats.n_walks++;
+    mmu->stats.n_walk_loads += n_walk;
+
+    tlb_insert(mmu->stlb, vpn);
+    tlb_insert(mmu->dtlb, vpn);
+
+    return n_walk;
+}
@@ -0,0 +1,58 @@
+#ifndef __TLB_H
+#define __TLB_H
+
+#include <stdbool.h>
+
+#define PAGE_TABLE_BASE (1UL << 40)  // page tables live above any 32 bit trace address
+#define PTE_SIZE 8
+#define MAX_WALK_LEVELS 4            // x86-64 style 4 level radix table
+
+typedef struct {
+  unsigned long vpn;
+  bool valid_f;
+  unsigned long last_use;
+} tlb_entry_t;
+
+// one set associative level of the TLB hierarchy, LRU replacement
+typedef struct {
+  int n_entry;
+  int assoc;
+  int n_set;
+  tlb_entry_t *entries;  // [set * assoc + way]
+  unsigned long use_clock;
+} tlb_t;
+
+typedef struct {
+  long n_accesses;
+  long n_dtlb_hits;
+  long n_stlb_hits;
+  long n_walks;
+  long n_walk_loads;   // page table entries read by the walks
+  long n_walk_misses;  // ... that missed in the data cache
+} tlb_stats_t;
+
+/*
+ * A core's translation hardware: an L1 dTLB backed by a unified STLB,
+ * with a page table walk on a miss in both. The trace addresses are taken
+ * as virtual and mapped one to one, so only the cost of translating changes.
+ */
+typedef struct {
+  long page_size;  // 4K, 2M or 1G
+  int page_bits;
+  tlb_t *dtlb;
+  tlb_t *stlb;
+  tlb_stats_t stats;
+} mmu_t;
+
+mmu_t *make_mmu(long page_size);
+void free_mmu(mmu_t *mmu);
+
+/* Translates addr. On a miss in both TLBs, fills walk_addrs with the
+ * addresses of the page table entries to load (at most MAX_WALK_LEVELS),
+ * and returns how many there are; returns 0 on a TLB hit.
+ */
+int mmu_translate(mmu_t *mmu, unsigned long addr, unsigned long *walk_addrs);
+
+bool is_valid_page_size(long page_size);
+
+#endif  // TLB
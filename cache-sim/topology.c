@@ -0,0 +1,46 @@
+#include <stdlib.h>
+
+#include "topology.h"
+
+topology_t *make_topology(int n_core, int n_socket, int block_size, int local_latency, int remote_latency) {
+    topology_t *topology = malloc(sizeof(topology_t));
+
+    topology->n_socket = n_socket;
+    topology->cores_per_socket = n_core / n_socket;
+    topology->block_size = block_size;
+    topology->local_latency = local_latency;
+    topology->remote_latency = remote_latency;
+
+    topology->directory = make_block_table(sizeof(directory_entry_t));
+
+    topology->stats = calloc(n_socket, sizeof(socket_stats_t));
+
+    return topology;
+}
+
+void free_topology(topology_t *topology) {
+    free_block_table(topology->directory);
+    free(topology->stats);
+    free(topology);
+}
+
+unsigned int directory_remote_sockets(topology_t *topology, int socket, unsigned long addr) {
+    unsigned long block_addr = addr - addr % topology->block_size;
+    directory_entry_t *entry = block_table_find(topology->directory, block_addr);
+    if (entry == NULL)
+        return 0;
+    return entry->socket_mask & ~(1u << socket);
+}
+
+/* The directory is never told about evictions, so a socket stays in a
+ * block's mask until a miss invalidates it. Forwarding to a socket that
+ * silently dropped its copy costs a request that finds nothing.
+ */
+void directory_update(topology_t *topology, int socket, unsigned long addr, bool invalidate_f) {
+    unsigned long block_addr = addr - addr % topology->block_size;
+    directory_entry_t *entry = block_table_get(topology->directory, block_addr, NULL);
+
+    if (invalidate_f)
+        entry->socket_mask = 0;
+    entry->socket_mask |= 1u << socket;
+}
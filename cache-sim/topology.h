@@ -0,0 +1,58 @@
+#ifndef __TOPOLOGY_H
+#define __TOPOLOGY_H
+
+#include <stdbool.h>
+#include "block_table.h"
+#include "cache_stats.h"
+
+#define DEFAULT_LOCAL_LATENCY 100   // cycles for a miss served within the socket
+#define DEFAULT_REMOTE_LATENCY 300  // cycles for a miss that has to go through the directory
+#define CONTROL_MSG_SIZE 8          // bytes of a request or invalidation between sockets
+
+// directory entry: which sockets may hold a copy of a block
+typedef struct {
+  unsigned int socket_mask;
+} directory_entry_t;
+
+typedef struct {
+  long n_misses;             // misses by the socket's cores
+  long n_remote_misses;      // ... that the directory sent to other sockets
+  long n_remote_snoops;      // requests from other sockets snooped by this socket
+  long n_remote_snoop_hits;  // ... that found a copy here
+  long B_cross_socket;       // requests and data sent between sockets for this socket's misses
+  long total_latency;        // summed latency of the socket's misses, in cycles
+} socket_stats_t;
+
+/*
+ * Groups the cores into sockets. Cores snoop each other on their socket's
+ * bus as before, and a directory tracking which sockets may hold each block
+ * forwards misses to the other sockets only when they need to see them.
+ */
+typedef struct {
+  int n_socket;
+  int cores_per_socket;
+  int block_size;
+  int local_latency;
+  int remote_latency;
+
+  block_table_t *directory;  // of directory_entry_t
+
+  socket_stats_t *stats;  // [socket]
+} topology_t;
+
+topology_t *make_topology(int n_core, int n_socket, int block_size, int local_latency, int remote_latency);
+void free_topology(topology_t *topology);
+
+static inline int socket_of(topology_t *topology, int core) {
+  return core / topology->cores_per_socket;
+}
+
+/* Sockets other than socket that may hold a copy of addr's block. */
+unsigned int directory_remote_sockets(topology_t *topology, int socket, unsigned long addr);
+
+/* Records that socket now holds addr's block, and, if the miss
+ * invalidated every other copy, that no other socket does.
+ */
+void directory_update(topology_t *topology, int socket, unsigned long addr, bool invalidate_f);
+
+#endif  // TOPOLOGY
@@ -0,0 +1,278 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define INITIAL_RECORDS 4096
+
+bool parse_trace_record(const char *line, int *core, trace_record_t *record, bool *timed_f) {
+    char *end;
+
+    *core = strtol(line, &end, 10);
+    if (end == line)
+        return false;
+
+    while (*end == ' ' || *end == '\t')
+        end++;
+    if (*end != 'r' && *end != 'w')
+        return false;
+    record->cmd = *end++;
+
+    const char *field = end;
+    record->addr = strtoul(field, &end, 16);
+    if (end == field)
+        return false;
+
+    field = end;
+    record->time = strtoul(field, &end, 10);
+    *timed_f = end != field;
+
+    return true;
+}
+
+static void append(trace_stream_t *stream, const trace_record_t *record) {
+    if (stream->n_record == stream->n_alloc) {
+        stream->n_alloc *= 2;
+        stream->records = realloc(stream->records, stream->n_alloc * sizeof(trace_record_t));
+    }
+    stream->records[stream->n_record++] = *record;
+}
+
+// what one loader thread reads, and whether it could
+typedef struct {
+    char *path;
+    trace_stream_t *streams;
+    int n_core;
+    int core;  // -1 to split the file by the records' core field
+    int bad_core;
+    bool ok_f;
+} load_job_t;
+
+static void *load_file(void *arg) {
+    load_job_t *job = arg;
+    FILE *file = fopen(job->path, "r");
+    if (file == NULL) {
+        job->ok_f = false;
+        job->bad_core = job->core;
+        return NULL;
+    }
+
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, file) != -1) {
+        int core;
+        bool timed_f;
+        trace_record_t record;
+        if (!parse_trace_record(line, &core, &record, &timed_f))
+            continue;
+
+        // a file of its own decides the core, otherwise the record does
+        if (job->core >= 0) {
+            core = job->core;
+        } else if (core < 0 || core >= job->n_core) {
+            job->ok_f = false;
+            job->bad_core = core;
+            break;
+        }
+
+        trace_stream_t *stream = &job->streams[core];
+        if (!timed_f)
+            record.time = stream->n_record;
+        append(stream, &record);
+    }
+
+    free(line);
+    fclose(file);
+    return NULL;
+}
+
+/* Merges the sorted runs a[lo, mid) and a[mid, hi) into out, keeping
+ * records with equal times in stream order.
+ */
+static void merge_runs(const trace_record_t *a, trace_record_t *out, long lo, long mid, long hi) {
+    long i = lo, j = mid;
+    for (long k = lo; k < hi; k++) {
+        if (i < mid && (j == hi || a[i].time <= a[j].time))
+            out[k] = a[i++];
+        else
+            out[k] = a[j++];
+    }
+}
+
+/* Sorts a stream by time, stably, so that the merge sees every core's
+ * records in time order. Streams that are already in order, as traces
+ * written as they ran are, are left alone.
+ */
+static void sort_by_time(trace_stream_t *stream) {
+    long n = stream->n_record;
+    long i = 1;
+    while (i < n && stream->records[i - 1].time <= stream->records[i].time)
+        i++;
+    if (i >= n)
+        return;
+
+    // bottom up merge sort, runs of width records doubling each pass
+    trace_record_t *from = stream->records;
+    trace_record_t *to = malloc(n * sizeof(trace_record_t));
+    for (long width = 1; width < n; width *= 2) {
+        for (long lo = 0; lo < n; lo += 2 * width) {
+            long mid = lo + width < n ? lo + width : n;
+            long hi = lo + 2 * width < n ? lo + 2 * width : n;
+            merge_runs(from, to, lo, mid, hi);
+        }
+        trace_record_t *tmp = from;
+        from = to;
+        to = tmp;
+    }
+    free(to);
+    if (from != stream->records)
+        stream->n_alloc = n;
+    stream->records = from;
+}
+
+/* Returns the trace file of core, the pattern with its %d replaced by the
+ * core number. The pattern is never used as a format string.
+ */
+static char *core_trace_path(const char *pattern, int core) {
+    const char *conversion = strstr(pattern, "%d");
+    int prefix_len = conversion - pattern;
+    const char *after = conversion + 2;
+    int n = strlen(pattern) + 16;
+    char *path = malloc(n);
+    snprintf(path, n, "%.*s%d%s", prefix_len, pattern, core, after);
+    return path;
+}
+
+bool is_per_core_pattern(const char *path) {
+    const char *conversion = strstr(path, "%d");
+    if (conversion == NULL)
+        return false;
+    // the %d must be the only % in the name
+    return strchr(path, '%') == conversion && strchr(conversion + 1, '%') == NULL;
+}
+
+trace_stream_t *load_trace_streams(const char *path, int n_core, bool per_core_f, int *bad_core) {
+    if (per_core_f && !is_per_core_pattern(path)) {
+        *bad_core = -1;
+        return NULL;
+    }
+
+    trace_stream_t *streams = malloc(n_core * sizeof(trace_stream_t));
+    for (int i = 0; i < n_core; i++) {
+        streams[i].n_record = 0;
+        streams[i].n_alloc = INITIAL_RECORDS;
+        streams[i].records = malloc(streams[i].n_alloc * sizeof(trace_record_t));
+    }
+
+    int n_job = per_core_f ? n_core : 1;
+    load_job_t *jobs = malloc(n_job * sizeof(load_job_t));
+    pthread_t *threads = malloc(n_job * sizeof(pthread_t));
+
+    for (int i = 0; i < n_job; i++) {
+        if (per_core_f)
+            jobs[i].path = core_trace_path(path, i);
+        else
+            jobs[i].path = strdup(path);
+        jobs[i].streams = streams;
+        jobs[i].n_core = n_core;
+        jobs[i].core = per_core_f ? i : -1;
+        jobs[i].ok_f = true;
+        pthread_create(&threads[i], NULL, load_file, &jobs[i]);
+    }
+
+    bool ok_f = true;
+    for (int i = 0; i < n_job; i++) {
+        pthread_join(threads[i], NULL);
+        if (ok_f && !jobs[i].ok_f) {
+            ok_f = false;
+            *bad_core = jobs[i].bad_core;
+        }
+        free(jobs[i].path);
+    }
+
+    free(threads);
+    free(jobs);
+
+    if (!ok_f) {
+        free_trace_streams(streams, n_core);
+        return NULL;
+    }
+    for (int i = 0; i < n_core; i++) {
+        sort_by_time(&streams[i]);
+    }
+    return streams;
+}
+
+void free_trace_streams(trace_stream_t *streams, int n_core) {
+    for (int i = 0; i < n_core; i++) {
+        free(streams[i].records);
+    }
+    free(streams);
+}
+
+static bool earlier(trace_merger_t *merger, int a, int b) {
+    unsigned long time_a = merger->streams[a].records[merger->next[a]].time;
+    unsigned long time_b = merger->streams[b].records[merger->next[b]].time;
+    return time_a < time_b || (time_a == time_b && a < b);
+}
+
+static void sift_down(trace_merger_t *merger, int i) {
+    int *heap = merger->heap;
+    while (true) {
+        int first = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < merger->n_heap && earlier(merger, heap[left], heap[first]))
+            first = left;
+        if (right < merger->n_heap && earlier(merger, heap[right], heap[first]))
+            first = right;
+        if (first == i)
+            return;
+
+        int tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
+    }
+}
+
+trace_merger_t *make_trace_merger(trace_stream_t *streams, int n_core) {
+    trace_merger_t *merger = malloc(sizeof(trace_merger_t));
+
+    merger->streams = streams;
+    merger->next = calloc(n_core, sizeof(long));
+    merger->heap = malloc(n_core * sizeof(int));
+    merger->n_heap = 0;
+
+    for (int i = 0; i < n_core; i++) {
+        if (streams[i].n_record > 0)
+            merger->heap[merger->n_heap++] = i;
+    }
+    for (int i = merger->n_heap / 2 - 1; i >= 0; i--)
+        sift_down(merger, i);
+
+    return merger;
+}
+
+void free_trace_merger(trace_merger_t *merger) {
+    free(merger->next);
+    free(merger->heap);
+    free(merger);
+}
+
+bool next_trace_record(trace_merger_t *merger, int *core, trace_record_t **record) {
+    if (merger->n_heap == 0)
+        return false;
+
+    *core = merger->heap[0];
+    *record = &merger->streams[*core].records[merger->next[*core]++];
+
+    // the core stays on top with its next record, or leaves the heap
+    if (merger->next[*core] == merger->streams[*core].n_record)
+        merger->heap[0] = merger->heap[--merger->n_heap];
+    sift_down(merger, 0);
+
+    return true;
+}
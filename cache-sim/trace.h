@@ -0,0 +1,66 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdbool.h>
+
+/*
+ * Timed traces. A record may carry a 4th field, a timestamp or
+ * instruction count: <core> <r|w> <hexaddr> [<time>]. A record without
+ * one gets its position in its core's stream, so untimed cores interleave
+ * round robin.
+ *
+ * Each core's records are loaded into their own stream, either by
+ * splitting a single trace or from one trace file per core (read by one
+ * thread per file), and the streams are then merged by time. The merge
+ * needs every stream in time order, so a stream whose times go backwards
+ * is sorted after loading, keeping records with equal times in trace
+ * order.
+ */
+
+typedef struct {
+  unsigned long addr;
+  unsigned long time;
+  char cmd;  // 'r' or 'w', as in the trace
+} trace_record_t;
+
+typedef struct {
+  trace_record_t *records;
+  long n_record;
+  long n_alloc;
+} trace_stream_t;
+
+/* Parses one trace line, setting timed_f if it has a time field. Returns
+ * false if the line is not a record.
+ */
+bool parse_trace_record(const char *line, int *core, trace_record_t *record, bool *timed_f);
+
+/* Returns whether path names a trace per core: it has a %d, and no other
+ * % conversion.
+ */
+bool is_per_core_pattern(const char *path);
+
+/* Loads n_core streams. If per_core_f, path is a pattern with a %d for the
+ * core number (see is_per_core_pattern), and the core field of every
+ * record is ignored. Returns NULL if a file cannot be read, with bad_core
+ * set to the core whose file it was (-1 for the single trace or a bad
+ * pattern), or a record names a core >= n_core, with bad_core set to that
+ * core.
+ */
+trace_stream_t *load_trace_streams(const char *path, int n_core, bool per_core_f, int *bad_core);
+void free_trace_streams(trace_stream_t *streams, int n_core);
+
+// merges the streams in time order, ties go to the lower core
+typedef struct {
+  trace_stream_t *streams;
+  long *next;  // [core] index of the core's next record
+  int *heap;   // cores with records left, ordered by their next record's time
+  int n_heap;
+} trace_merger_t;
+
+trace_merger_t *make_trace_merger(trace_stream_t *streams, int n_core);
+void free_trace_merger(trace_merger_t *merger);
+
+/* Returns false once every stream is exhausted. */
+bool next_trace_record(trace_merger_t *merger, int *core, trace_record_t **record);
+
+#endif  // TRACE
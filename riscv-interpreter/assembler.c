@@ -0,0 +1,474 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "decode.h"
+#include "assembler.h"
+
+#define MAX_OPERANDS 3
+#define CACHE_MAGIC "RVPROG1"
+#define BRANCH_IMM_BITS 13 // signed byte offsets a conditional branch can reach
+#define JAL_IMM_BITS 21    // ... and jal
+
+/**
+ * A label and the index of the instruction it names
+ */
+struct label
+{
+    char *name;
+    int index;
+};
+
+struct labels
+{
+    struct label *labels;
+    int n;
+    int max;
+};
+
+/**
+ * An instruction split into the operation and its trimmed operands
+ */
+struct parsed
+{
+    char op[LINE_SIZE];
+    char operands[MAX_OPERANDS][LINE_SIZE];
+    int n_operands;
+};
+
+/************** BEGIN HELPER FUNCTIONS ***************/
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static bool is_label_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+/**
+ * Returns whether an operand names a label rather than a number
+ */
+static bool is_label_ref(const char *s)
+{
+    return (*s >= 'a' && *s <= 'z') || *s == '_' || *s == '.';
+}
+
+/**
+ * If line starts with "<label>:", returns the label's length, otherwise 0
+ */
+static int label_length(const char *line)
+{
+    int len = 0;
+    while (is_label_char(line[len]))
+        len++;
+    return (len > 0 && line[len] == ':' && is_label_ref(line)) ? len : 0;
+}
+
+static int find_label(struct labels *labels, const char *name)
+{
+    for (int i = 0; i < labels->n; i++)
+    {
+        if (strcmp(labels->labels[i].name, name) == 0)
+        {
+            return labels->labels[i].index;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Skips the labels at the start of the line, adding them to labels with
+ * the given instruction index if labels is not NULL. Returns NULL after
+ * printing an error if a label is already defined.
+ */
+static const char *skip_labels(const char *line, struct labels *labels, int index)
+{
+    int len;
+    while ((len = label_length(line)) > 0)
+    {
+        if (labels)
+        {
+            char *name = strndup(line, len);
+            if (find_label(labels, name) >= 0)
+            {
+                fprintf(stderr, "Duplicate label: %s\n", name);
+                free(name);
+                return NULL;
+            }
+            if (labels->n == labels->max)
+            {
+                labels->max = labels->max ? 2 * labels->max : 16;
+                labels->labels = realloc(labels->labels, labels->max * sizeof(struct label));
+            }
+            labels->labels[labels->n++] = (struct label){name, index};
+        }
+        line += len + 1;
+        while (is_space(*line))
+            line++;
+    }
+    return line;
+}
+
+/**
+ * Copies s into dst without leading and trailing space
+ */
+static void copy_trimmed(char *dst, const char *s, int len)
+{
+    while (len > 0 && is_space(*s))
+    {
+        s++;
+        len--;
+    }
+    while (len > 0 && is_space(s[len - 1]))
+        len--;
+    memcpy(dst, s, len);
+    dst[len] = '\0';
+}
+
+/**
+ * Splits an instruction into its operation and comma separated operands
+ */
+static void parse(const char *line, struct parsed *parsed)
+{
+    int op_len = 0;
+    while (line[op_len] && !is_space(line[op_len]))
+        op_len++;
+    copy_trimmed(parsed->op, line, op_len);
+
+    parsed->n_operands = 0;
+    const char *s = line + op_len;
+    while (is_space(*s))
+        s++;
+    while (*s && parsed->n_operands < MAX_OPERANDS)
+    {
+        const char *comma = strchr(s, ',');
+        int len = comma ? comma - s : (int)strlen(s);
+        copy_trimmed(parsed->operands[parsed->n_operands++], s, len);
+        s += len + (comma ? 1 : 0);
+    }
+}
+
+/**
+ * Writes an instruction to line, truncated to LINE_SIZE characters like
+ * the input
+ */
+static void format_line(char *line, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, LINE_SIZE, format, args);
+    va_end(args);
+}
+
+/**
+ * Returns the number of instructions li expands to for the immediate
+ */
+static int li_size(const char *imm)
+{
+    int v = strtol(imm, NULL, 0);
+    bool fits_addi = v >= -2048 && v < 2048;
+    bool fits_lui = (v & 0xFFF) == 0;
+    return (fits_addi || fits_lui) ? 1 : 2;
+}
+
+/**
+ * Returns the number of instructions the line assembles to
+ */
+static int instruction_size(const char *line)
+{
+    struct parsed parsed;
+    parse(line, &parsed);
+    if (strcmp(parsed.op, "li") == 0 && parsed.n_operands == 2)
+    {
+        return li_size(parsed.operands[1]);
+    }
+    return 1;
+}
+/*************** END HELPER FUNCTIONS ****************/
+
+/**
+ * Resolves a branch or jump target: the byte offset from the instruction
+ * at index to the label, or the operand itself if it is a number. A label
+ * offset must fit the instruction's signed imm_bits bit immediate.
+ */
+static bool resolve(struct labels *labels, const char *target, int index, int imm_bits, char *out)
+{
+    if (!is_label_ref(target))
+    {
+        strcpy(out, target);
+        return true;
+    }
+
+    int target_index = find_label(labels, target);
+    if (target_index < 0)
+    {
+        fprintf(stderr, "Unknown label: %s\n", target);
+        return false;
+    }
+    int offset = (target_index - index) * 4;
+    if (offset < -(1 << (imm_bits - 1)) || offset >= 1 << (imm_bits - 1))
+    {
+        fprintf(stderr, "Label out of range: %s\n", target);
+        return false;
+    }
+    sprintf(out, "%d", offset);
+    return true;
+}
+
+/**
+ * Writes the instructions for one line to lines, starting at instruction
+ * index. Returns the number written, or -1 on error.
+ */
+static int expand(struct labels *labels, const char *line, int index, char lines[2][LINE_SIZE])
+{
+    struct parsed p;
+    parse(line, &p);
+    char (*ops)[LINE_SIZE] = p.operands;
+    char target[LINE_SIZE];
+
+    if (strcmp(p.op, "nop") == 0 && p.n_operands == 0)
+    {
+        strcpy(lines[0], "addi x0, x0, 0");
+    }
+    else if (strcmp(p.op, "mv") == 0 && p.n_operands == 2)
+    {
+        format_line(lines[0], "addi %s, %s, 0", ops[0], ops[1]);
+    }
+    else if (strcmp(p.op, "not") == 0 && p.n_operands == 2)
+    {
+        format_line(lines[0], "xori %s, %s, -1", ops[0], ops[1]);
+    }
+    else if (strcmp(p.op, "neg") == 0 && p.n_operands == 2)
+    {
+        format_line(lines[0], "sub %s, x0, %s", ops[0], ops[1]);
+    }
+    else if (strcmp(p.op, "li") == 0 && p.n_operands == 2)
+    {
+        // lui loads the upper 20 bits, rounded so that the sign extended
+        // lower 12 bits added by addi make up the difference
+        int v = strtol(ops[1], NULL, 0);
+        int lo = sign_extend(v, 12);
+        unsigned int hi = ((unsigned int)v - lo) >> 12;
+        if (li_size(ops[1]) == 1 && lo == v)
+        {
+            format_line(lines[0], "addi %s, x0, %d", ops[0], v);
+            return 1;
+        }
+        format_line(lines[0], "lui %s, 0x%x", ops[0], hi);
+        if (lo == 0)
+        {
+            return 1;
+        }
+        format_line(lines[1], "addi %s, %s, %d", ops[0], ops[0], lo);
+        return 2;
+    }
+    else if (strcmp(p.op, "j") == 0 && p.n_operands == 1)
+    {
+        if (!resolve(labels, ops[0], index, JAL_IMM_BITS, target))
+            return -1;
+        format_line(lines[0], "jal x0, %s", target);
+    }
+    else if (strcmp(p.op, "jal") == 0 && p.n_operands == 1)
+    {
+        if (!resolve(labels, ops[0], index, JAL_IMM_BITS, target))
+            return -1;
+        format_line(lines[0], "jal x1, %s", target);
+    }
+    else if (strcmp(p.op, "jr") == 0 && p.n_operands == 1)
+    {
+        format_line(lines[0], "jalr x0, %s, 0", ops[0]);
+    }
+    else if (strcmp(p.op, "ret") == 0 && p.n_operands == 0)
+    {
+        strcpy(lines[0], "jalr x0, x1, 0");
+    }
+    else if ((strcmp(p.op, "beqz") == 0 || strcmp(p.op, "bnez") == 0) && p.n_operands == 2)
+    {
+        if (!resolve(labels, ops[1], index, BRANCH_IMM_BITS, target))
+            return -1;
+        format_line(lines[0], "%.3s %s, x0, %s", p.op, ops[0], target);
+    }
+    else if (p.op[0] == 'b' && p.n_operands == 3 && is_label_ref(ops[2]))
+    {
+        if (!resolve(labels, ops[2], index, BRANCH_IMM_BITS, target))
+            return -1;
+        format_line(lines[0], "%s %s, %s, %s", p.op, ops[0], ops[1], target);
+    }
+    else if (strcmp(p.op, "jal") == 0 && p.n_operands == 2 && is_label_ref(ops[1]))
+    {
+        if (!resolve(labels, ops[1], index, JAL_IMM_BITS, target))
+            return -1;
+        format_line(lines[0], "jal %s, %s", ops[0], target);
+    }
+    else
+    {
+        // a real instruction with numeric operands, kept as written
+        strncpy(lines[0], line, LINE_SIZE - 1);
+        lines[0][LINE_SIZE - 1] = '\0';
+    }
+    return 1;
+}
+
+int assemble(char **source, int n_source, char **program, int max_instructions)
+{
+    struct labels labels = {NULL, 0, 0};
+
+    // first pass: find the index of every label
+    int index = 0;
+    for (int i = 0; i < n_source && index >= 0; i++)
+    {
+        const char *line = skip_labels(source[i], &labels, index);
+        if (line == NULL)
+        {
+            index = -1;
+        }
+        else if (*line)
+        {
+            index += instruction_size(line);
+        }
+    }
+
+    // second pass: write out the instructions
+    int n = index < 0 ? -1 : 0;
+    for (int i = 0; i < n_source && n >= 0; i++)
+    {
+        const char *line = skip_labels(source[i], NULL, 0);
+        if (*line == '\0')
+        {
+            continue;
+        }
+
+        char lines[2][LINE_SIZE];
+        int size = expand(&labels, line, n, lines);
+        for (int j = 0; j < size; j++, n++)
+        {
+            if (n < max_instructions)
+            {
+                strcpy(program[n], lines[j]);
+            }
+        }
+        if (size < 0)
+        {
+            n = -1;
+        }
+    }
+
+    for (int i = 0; i < labels.n; i++)
+    {
+        free(labels.labels[i].name);
+    }
+    free(labels.labels);
+    return n;
+}
+
+uint64_t hash_source(char **source, int n_source, int no_of_instructions)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < n_source; i++)
+    {
+        for (const char *c = source[i]; *c; c++)
+        {
+            hash = (hash ^ (uint8_t)*c) * 0x100000001b3ULL;
+        }
+        hash = (hash ^ '\n') * 0x100000001b3ULL;
+    }
+    return hash ^ (uint64_t)no_of_instructions;
+}
+
+/*
+ * A cache file is CACHE_MAGIC, the key and the number of instructions,
+ * then for each instruction the op, registers and immediate followed by
+ * the length of the trace (-1 for none) and the trace itself.
+ */
+struct cached_inst
+{
+    uint8_t op;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;
+    int32_t trace_len;
+};
+
+inst_t *load_program_cache(const char *path, uint64_t key, int no_of_instructions)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    char magic[sizeof(CACHE_MAGIC)];
+    uint64_t file_key;
+    int32_t n;
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&file_key, sizeof(file_key), 1, file) != 1 || file_key != key ||
+        fread(&n, sizeof(n), 1, file) != 1 || n != no_of_instructions)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    inst_t *program = calloc(no_of_instructions + 1, sizeof(inst_t));
+    for (int i = 0; i < n; i++)
+    {
+        struct cached_inst cached;
+        bool ok = fread(&cached, sizeof(cached), 1, file) == 1 && cached.trace_len >= -1 &&
+                  cached.trace_len < LINE_SIZE;
+        if (ok && cached.trace_len >= 0)
+        {
+            program[i].trace = malloc(cached.trace_len + 1);
+            ok = fread(program[i].trace, 1, cached.trace_len, file) == (size_t)cached.trace_len;
+            program[i].trace[cached.trace_len] = '\0';
+        }
+        if (!ok || cached.op >= NO_OF_OPCODES || cached.rd >= 32 || cached.rs1 >= 32 || cached.rs2 >= 32)
+        {
+            // truncated or corrupt, assemble again instead
+            for (int j = 0; j <= i; j++)
+            {
+                free(program[j].trace);
+            }
+            free(program);
+            fclose(file);
+            return NULL;
+        }
+        program[i].op = cached.op;
+        program[i].rd = cached.rd;
+        program[i].rs1 = cached.rs1;
+        program[i].rs2 = cached.rs2;
+        program[i].imm = cached.imm;
+    }
+    fclose(file);
+    return program;
+}
+
+void store_program_cache(const char *path, uint64_t key, inst_t *program, int no_of_instructions)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot write program cache %s\n", path);
+        return;
+    }
+
+    int32_t n = no_of_instructions;
+    fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC), file);
+    fwrite(&key, sizeof(key), 1, file);
+    fwrite(&n, sizeof(n), 1, file);
+    for (int i = 0; i < n; i++)
+    {
+        inst_t *inst = &program[i];
+        struct cached_inst cached = {inst->op, inst->rd, inst->rs1, inst->rs2, inst->imm,
+                                     inst->trace ? (int32_t)strlen(inst->trace) : -1};
+        fwrite(&cached, sizeof(cached), 1, file);
+        if (inst->trace)
+        {
+            fwrite(inst->trace, 1, cached.trace_len, file);
+        }
+    }
+    fclose(file);
+}
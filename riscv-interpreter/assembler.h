@@ -0,0 +1,36 @@
+#include <stdint.h>
+
+struct inst;
+
+/**
+ * Assembles source, one line of lowercase assembly without comments per
+ * entry, into program, one instruction per line. Labels ("loop:", on their
+ * own line or before an instruction) may be used as the target of
+ * branches and jumps, and the pseudo-instructions
+ *
+ *     nop, mv, not, neg, li, j, jr, ret, beqz, bnez, jal <label>
+ *
+ * are expanded. Lines that use neither are copied unchanged.
+ * Writes at most max_instructions lines of LINE_SIZE characters.
+ * Returns the number of instructions the program needs, which may be more
+ * than max_instructions, or -1 after printing an error.
+ */
+int assemble(char **source, int n_source, char **program, int max_instructions);
+
+/**
+ * Returns a hash of the source and the number of instruction slots, which
+ * identifies the assembled program in a cache file.
+ */
+uint64_t hash_source(char **source, int n_source, int no_of_instructions);
+
+/**
+ * Reads a decoded program of no_of_instructions instructions saved by
+ * store_program_cache. Returns NULL if the file does not exist or was
+ * written for a different key.
+ */
+struct inst *load_program_cache(const char *path, uint64_t key, int no_of_instructions);
+
+/**
+ * Saves a decoded program, including its traces, for load_program_cache.
+ */
+void store_program_cache(const char *path, uint64_t key, struct inst *program, int no_of_instructions);
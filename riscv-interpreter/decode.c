@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "decode.h"
+
+/************** BEGIN HELPER FUNCTIONS ***************/
+const int R_TYPE = 0;
+const int I_TYPE = 1;
+const int MEM_TYPE = 2;
+const int U_TYPE = 3;
+const int B_TYPE = 4;
+const int J_TYPE = 5;
+const int UNKNOWN_TYPE = 6;
+
+/**
+ * Names of the operations, indexed by opcode
+ */
+static const char *op_names[NO_OF_OPCODES] = {
+    [OP_ADD] = "add", [OP_SUB] = "sub", [OP_AND] = "and", [OP_OR] = "or",
+    [OP_XOR] = "xor", [OP_SLT] = "slt", [OP_SLTU] = "sltu", [OP_SLL] = "sll",
+    [OP_SRL] = "srl", [OP_SRA] = "sra", [OP_MUL] = "mul", [OP_MULH] = "mulh",
+    [OP_MULHSU] = "mulhsu", [OP_MULHU] = "mulhu", [OP_DIV] = "div", [OP_DIVU] = "divu",
+    [OP_REM] = "rem", [OP_REMU] = "remu", [OP_ADDI] = "addi", [OP_ANDI] = "andi",
+    [OP_ORI] = "ori", [OP_XORI] = "xori", [OP_SLTI] = "slti", [OP_SLTIU] = "sltiu",
+    [OP_SLLI] = "slli", [OP_SRLI] = "srli", [OP_SRAI] = "srai", [OP_LW] = "lw",
+    [OP_LH] = "lh", [OP_LHU] = "lhu", [OP_LB] = "lb", [OP_LBU] = "lbu",
+    [OP_SW] = "sw", [OP_SH] = "sh", [OP_SB] = "sb", [OP_LUI] = "lui",
+    [OP_AUIPC] = "auipc", [OP_BEQ] = "beq", [OP_BNE] = "bne", [OP_BLT] = "blt",
+    [OP_BGE] = "bge", [OP_BLTU] = "bltu", [OP_BGEU] = "bgeu", [OP_JAL] = "jal",
+    [OP_JALR] = "jalr", [OP_ECALL] = "ecall"};
+
+/**
+ * Return the opcode for the given operation, or OP_NOP if there is none
+ */
+static int get_opcode(char *op)
+{
+    for (int i = OP_NOP + 1; i < NO_OF_OPCODES; i++)
+    {
+        if (strcmp(op_names[i], op) == 0)
+        {
+            return i;
+        }
+    }
+    return OP_NOP;
+}
+
+/**
+ * Return the type of instruction for the given opcode
+ * Available options are R_TYPE, I_TYPE, MEM_TYPE, U_TYPE, B_TYPE, J_TYPE, UNKNOWN_TYPE
+ */
+static int get_op_type(int opcode)
+{
+    if (opcode >= OP_ADD && opcode <= OP_REMU)
+    {
+        return R_TYPE;
+    }
+    if ((opcode >= OP_ADDI && opcode <= OP_SRAI) || opcode == OP_JALR)
+    {
+        return I_TYPE;
+    }
+    if (opcode >= OP_LW && opcode <= OP_SB)
+    {
+        return MEM_TYPE;
+    }
+    if (opcode == OP_LUI || opcode == OP_AUIPC)
+    {
+        return U_TYPE;
+    }
+    if (is_branch(opcode))
+    {
+        return B_TYPE;
+    }
+    if (opcode == OP_JAL)
+    {
+        return J_TYPE;
+    }
+    return UNKNOWN_TYPE;
+}
+/*************** END HELPER FUNCTIONS ****************/
+
+/**
+ * Copy of the C standard library isspace function
+ */
+int isspace(int c)
+{
+    return c == '\t' || c == '\n' ||
+           c == '\v' || c == '\f' || c == '\r' || c == ' ';
+}
+
+/**
+ * Given a string, trim any leading or trailing space surrounding it
+ */
+char *trim_spaces(char *s)
+{
+    while (isspace(*s)) // trim leading space
+        s++;
+
+    char *end = s + strlen(s) - 1;
+    while (end > s && isspace(*end)) // trim trailing space
+        end--;
+    end[1] = '\0';
+
+    return s;
+}
+
+int sign_extend(int imm_v, int imm_num_bits)
+{
+    // only want the x LSBs: << by 32-x to remove extra bits and
+    // >> by 32-x to sign extend to 32 bits (since >> is arithmetic shift on ints)
+    return (imm_v << (32 - imm_num_bits)) >> (32 - imm_num_bits);
+}
+
+/**
+ * Given a hex or decimal string representing an x bit immediate value,
+ * convert it to an int and sign extend it to 32 bits.
+ */
+int process_imm(char *imm, int imm_num_bits)
+{
+    int imm_v = strtol(imm, NULL, 0);
+    return sign_extend(imm_v, imm_num_bits);
+}
+
+/**
+ * Given a register name such as x10, return its number
+ */
+static uint8_t process_reg(char *reg)
+{
+    return atoi(reg + 1) & 0x1F; // offset by 1 to remove x
+}
+
+/**
+ * Formats the operands the way the trace prints them
+ */
+static char *make_trace(const char *op, char *a, char *b, char *c)
+{
+    int len = strlen(op) + strlen(a) + strlen(b) + (c ? strlen(c) : 0) + 4;
+    char *trace = malloc(len);
+    if (c)
+        sprintf(trace, "%s/%s/%s/%s", op, a, b, c);
+    else
+        sprintf(trace, "%s/%s/%s", op, a, b);
+    return trace;
+}
+
+/**
+ * Turns instructions whose only effect is writing x0 into no-ops. Stores
+ * and branches have no destination, and jumps still jump (the link is
+ * dropped when they execute).
+ */
+static void drop_x0_writes(inst_t *inst, int op_type)
+{
+    bool no_effect = op_type == R_TYPE || op_type == U_TYPE ||
+                     (op_type == I_TYPE && inst->op != OP_JALR) ||
+                     (op_type == MEM_TYPE && inst->op < OP_SW);
+    if (inst->rd == 0 && no_effect)
+    {
+        inst->op = OP_NOP;
+    }
+}
+
+void decode_instruction(char *instruction, inst_t *inst)
+{
+    memset(inst, 0, sizeof(inst_t));
+
+    // Extracts and returns the substring before the first space character,
+    // by replacing the space character with a null-terminator.
+    // `instruction` is MODIFIED IN PLACE to point to the next character
+    // after the space. See `man strsep` for how this library function works.
+    char *op = strsep(&instruction, " ");
+    inst->op = get_opcode(op);
+    int op_type = get_op_type(inst->op); // type of instruction
+
+    if (op_type == R_TYPE)
+    {
+        char *rd = trim_spaces(strsep(&instruction, ","));
+        char *r1 = trim_spaces(strsep(&instruction, ","));
+        char *r2 = trim_spaces(instruction);
+        inst->trace = make_trace(op, rd, r1, r2);
+
+        inst->rd = process_reg(rd);
+        inst->rs1 = process_reg(r1);
+        inst->rs2 = process_reg(r2);
+    }
+    else if (op_type == I_TYPE)
+    {
+        char *rd = trim_spaces(strsep(&instruction, ","));
+        char *r1;
+        char *imm;
+        if (inst->op == OP_JALR && instruction && strchr(instruction, '('))
+        {
+            // jalr rd, imm(r1)
+            imm = trim_spaces(strsep(&instruction, "("));
+            r1 = trim_spaces(strsep(&instruction, ")"));
+        }
+        else
+        {
+            r1 = trim_spaces(strsep(&instruction, ","));
+            imm = trim_spaces(instruction);
+        }
+        inst->trace = make_trace(op, rd, r1, imm);
+
+        inst->rd = process_reg(rd);
+        inst->rs1 = process_reg(r1);
+        inst->imm = process_imm(imm, 12);
+    }
+    else if (op_type == MEM_TYPE)
+    {
+        // target is rd for loads and r2 for stores
+        char *target = trim_spaces(strsep(&instruction, ","));
+        char *imm = trim_spaces(strsep(&instruction, "("));
+        char *r1 = trim_spaces(strsep(&instruction, ")"));
+        inst->trace = make_trace(op, target, imm, r1);
+
+        inst->rd = process_reg(target);
+        inst->imm = process_imm(imm, 12);
+        inst->rs1 = process_reg(r1);
+    }
+    else if (op_type == U_TYPE)
+    {
+        char *rd = trim_spaces(strsep(&instruction, ","));
+        char *imm = trim_spaces(instruction);
+        inst->trace = make_trace(op, rd, imm, NULL);
+
+        inst->rd = process_reg(rd);
+        inst->imm = process_imm(imm, 20) << 12;
+    }
+    else if (op_type == J_TYPE)
+    {
+        char *rd = trim_spaces(strsep(&instruction, ","));
+        char *imm = trim_spaces(instruction);
+        inst->trace = make_trace(op, rd, imm, NULL);
+
+        inst->rd = process_reg(rd);
+        inst->imm = process_imm(imm, 21);
+    }
+    else if (op_type == B_TYPE)
+    {
+        char *r1 = trim_spaces(strsep(&instruction, ","));
+        char *r2 = trim_spaces(strsep(&instruction, ","));
+        char *imm = trim_spaces(instruction);
+        inst->trace = make_trace(op, r1, r2, imm);
+
+        inst->rs1 = process_reg(r1);
+        inst->rs2 = process_reg(r2);
+        inst->imm = process_imm(imm, 13);
+    }
+    else if (inst->op == OP_ECALL)
+    {
+        inst->trace = strdup(op);
+    }
+
+    drop_x0_writes(inst, op_type);
+}
+
+inst_t *decode_lines(char **program, int no_of_instructions)
+{
+    char buf[LINE_SIZE];
+
+    // one extra no-op at the end for the threaded engine to stop on
+    inst_t *decoded = calloc(no_of_instructions + 1, sizeof(inst_t));
+    for (int i = 0; i < no_of_instructions; i++)
+    {
+        // copy instructions so strsep does not modify original program
+        strncpy(buf, program[i], LINE_SIZE);
+        buf[LINE_SIZE - 1] = '\0';
+        decode_instruction(buf, &decoded[i]);
+    }
+    return decoded;
+}
+
+/**
+ * Decodes the fields of a machine instruction, without dropping writes
+ * to x0 or building the trace
+ */
+static void decode_fields(uint32_t word, inst_t *inst)
+{
+    memset(inst, 0, sizeof(inst_t));
+
+    int opcode = word & 0x7F;
+    int funct3 = (word >> 12) & 0x7;
+    int funct7 = word >> 25;
+    inst->rd = (word >> 7) & 0x1F;
+    inst->rs1 = (word >> 15) & 0x1F;
+    inst->rs2 = (word >> 20) & 0x1F;
+    int imm_i = (int32_t)word >> 20;
+
+    // indexed by funct3, OP_NOP where the encoding is not RV32IM
+    static const uint8_t alu_ops[8] = {OP_ADD, OP_SLL, OP_SLT, OP_SLTU, OP_XOR, OP_SRL, OP_OR, OP_AND};
+    static const uint8_t m_ops[8] = {OP_MUL, OP_MULH, OP_MULHSU, OP_MULHU, OP_DIV, OP_DIVU, OP_REM, OP_REMU};
+    static const uint8_t imm_ops[8] = {OP_ADDI, OP_SLLI, OP_SLTI, OP_SLTIU, OP_XORI, OP_SRLI, OP_ORI, OP_ANDI};
+    static const uint8_t load_ops[8] = {OP_LB, OP_LH, OP_LW, OP_NOP, OP_LBU, OP_LHU, OP_NOP, OP_NOP};
+    static const uint8_t store_ops[8] = {OP_SB, OP_SH, OP_SW, OP_NOP, OP_NOP, OP_NOP, OP_NOP, OP_NOP};
+    static const uint8_t branch_ops[8] = {OP_BEQ, OP_BNE, OP_NOP, OP_NOP, OP_BLT, OP_BGE, OP_BLTU, OP_BGEU};
+
+    switch (opcode)
+    {
+    case 0x33:
+        if (funct7 == 0x01)
+            inst->op = m_ops[funct3];
+        else if (funct7 == 0x20)
+            inst->op = funct3 == 0 ? OP_SUB : funct3 == 5 ? OP_SRA : OP_NOP;
+        else if (funct7 == 0x00)
+            inst->op = alu_ops[funct3];
+        break;
+    case 0x13:
+        inst->op = imm_ops[funct3];
+        inst->imm = imm_i;
+        if (funct3 == 5 && funct7 == 0x20)
+            inst->op = OP_SRAI;
+        if (funct3 == 1 || funct3 == 5)
+            inst->imm &= 0x1F;
+        break;
+    case 0x03:
+        inst->op = load_ops[funct3];
+        inst->imm = imm_i;
+        break;
+    case 0x23:
+        // the stored register goes in rd, as for the text form
+        inst->op = store_ops[funct3];
+        inst->rd = inst->rs2;
+        inst->imm = ((int32_t)(word & 0xFE000000) >> 20) | ((word >> 7) & 0x1F);
+        break;
+    case 0x37:
+    case 0x17:
+        inst->op = opcode == 0x37 ? OP_LUI : OP_AUIPC;
+        inst->imm = word & 0xFFFFF000;
+        break;
+    case 0x63:
+        inst->op = branch_ops[funct3];
+        inst->imm = sign_extend(((word >> 31) << 12) | (((word >> 7) & 0x1) << 11) |
+                                    (((word >> 25) & 0x3F) << 5) | (((word >> 8) & 0xF) << 1),
+                                13);
+        break;
+    case 0x6F:
+        inst->op = OP_JAL;
+        inst->imm = sign_extend(((word >> 31) << 20) | (((word >> 12) & 0xFF) << 12) |
+                                    (((word >> 20) & 0x1) << 11) | (((word >> 21) & 0x3FF) << 1),
+                                21);
+        break;
+    case 0x67:
+        inst->op = funct3 == 0 ? OP_JALR : OP_NOP;
+        inst->imm = imm_i;
+        break;
+    case 0x73:
+        if (word == 0x00000073)
+        {
+            inst->op = OP_ECALL;
+            inst->rd = inst->rs1 = 0;
+        }
+        break;
+    }
+
+    // fence, ebreak, csr instructions and unknown encodings
+    if (inst->op == OP_NOP)
+    {
+        memset(inst, 0, sizeof(inst_t));
+    }
+
+    // only branches and stores use rs2, and it is rd for stores
+    int op_type = get_op_type(inst->op);
+    if (op_type != R_TYPE && op_type != B_TYPE)
+    {
+        inst->rs2 = 0;
+    }
+}
+
+void decode_word(uint32_t word, inst_t *inst)
+{
+    decode_fields(word, inst);
+    drop_x0_writes(inst, get_op_type(inst->op));
+}
+
+char *disassemble(uint32_t word)
+{
+    inst_t fields;
+    inst_t *inst = &fields;
+    decode_fields(word, inst);
+    if (inst->op == OP_NOP)
+    {
+        return NULL;
+    }
+    if (inst->op == OP_ECALL)
+    {
+        return strdup(op_names[OP_ECALL]);
+    }
+
+    // the same trace the text form of the instruction would print
+    char a[16], b[16], c[16];
+    int op_type = get_op_type(inst->op);
+    if (op_type == R_TYPE)
+    {
+        sprintf(a, "x%d", inst->rd);
+        sprintf(b, "x%d", inst->rs1);
+        sprintf(c, "x%d", inst->rs2);
+    }
+    else if (op_type == I_TYPE)
+    {
+        sprintf(a, "x%d", inst->rd);
+        sprintf(b, "x%d", inst->rs1);
+        sprintf(c, "%d", inst->imm);
+    }
+    else if (op_type == MEM_TYPE)
+    {
+        sprintf(a, "x%d", inst->rd);
+        sprintf(b, "%d", inst->imm);
+        sprintf(c, "x%d", inst->rs1);
+    }
+    else if (op_type == B_TYPE)
+    {
+        sprintf(a, "x%d", inst->rs1);
+        sprintf(b, "x%d", inst->rs2);
+        sprintf(c, "%d", inst->imm);
+    }
+    else if (op_type == U_TYPE)
+    {
+        sprintf(a, "x%d", inst->rd);
+        sprintf(b, "0x%x", (uint32_t)inst->imm >> 12);
+    }
+    else
+    {
+        sprintf(a, "x%d", inst->rd);
+        sprintf(b, "%d", inst->imm);
+    }
+    bool three_f = op_type != U_TYPE && op_type != J_TYPE;
+    return make_trace(op_names[inst->op], a, b, three_f ? c : NULL);
+}
@@ -0,0 +1,124 @@
+#include <stdint.h>
+
+#define LINE_SIZE 256 // longest line of assembly, including the terminator
+
+/**
+ * The operations the interpreter can execute. OP_NOP covers lines that are
+ * not instructions, and instructions whose only effect would be writing x0.
+ */
+enum opcode
+{
+    OP_NOP,
+    // register-register
+    OP_ADD,
+    OP_SUB,
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_SLT,
+    OP_SLTU,
+    OP_SLL,
+    OP_SRL,
+    OP_SRA,
+    OP_MUL,
+    OP_MULH,
+    OP_MULHSU,
+    OP_MULHU,
+    OP_DIV,
+    OP_DIVU,
+    OP_REM,
+    OP_REMU,
+    // register-immediate
+    OP_ADDI,
+    OP_ANDI,
+    OP_ORI,
+    OP_XORI,
+    OP_SLTI,
+    OP_SLTIU,
+    OP_SLLI,
+    OP_SRLI,
+    OP_SRAI,
+    // loads and stores
+    OP_LW,
+    OP_LH,
+    OP_LHU,
+    OP_LB,
+    OP_LBU,
+    OP_SW,
+    OP_SH,
+    OP_SB,
+    // upper immediates
+    OP_LUI,
+    OP_AUIPC,
+    // control transfer
+    OP_BEQ,
+    OP_BNE,
+    OP_BLT,
+    OP_BGE,
+    OP_BLTU,
+    OP_BGEU,
+    OP_JAL,
+    OP_JALR,
+    // system
+    OP_ECALL,
+    NO_OF_OPCODES
+};
+
+/**
+ * A decoded instruction. Registers are plain indices and the immediate is
+ * already sign extended (and for lui and auipc, already shifted into place),
+ * so executing it involves no string handling.
+ */
+struct inst
+{
+    uint8_t op;  // enum opcode
+    uint8_t rd;  // destination, or the register stored by sw/sh/sb
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;
+    char *trace; // the operands as the trace prints them, NULL for none
+    const void *handler; // where the threaded engine executes this op
+};
+typedef struct inst inst_t;
+
+/**
+ * Returns whether op is a conditional branch
+ */
+static inline int is_branch(int op)
+{
+    return op >= OP_BEQ && op <= OP_BGEU;
+}
+
+/**
+ * Sign extend an x bit immediate value to 32 bits
+ */
+int sign_extend(int imm_v, int imm_num_bits);
+
+/**
+ * Decodes one line of the program into inst. The line is modified in
+ * place. inst->trace is allocated and must be freed by the caller.
+ */
+void decode_instruction(char *instruction, inst_t *inst);
+
+/**
+ * Decodes every line of a text program. The result has one extra zeroed
+ * entry at the end and must be freed by the caller, along with the traces.
+ */
+inst_t *decode_lines(char **program, int no_of_instructions);
+
+/**
+ * Decodes one 32 bit RV32IM machine instruction into inst. ecall decodes
+ * to OP_ECALL, which halts the program when a7 holds the exit system call
+ * (93) and does nothing otherwise. Other encodings outside RV32IM, such as
+ * fence, decode to a silent no-op.
+ * inst->trace is left NULL, since formatting it is by far the slowest
+ * part of decoding; disassemble() provides it when it is needed.
+ */
+void decode_word(uint32_t word, inst_t *inst);
+
+/**
+ * Returns the trace for a machine instruction, formatted as the text form
+ * of the instruction would print it, or NULL for encodings outside RV32IM.
+ * The string is allocated and must be freed by the caller.
+ */
+char *disassemble(uint32_t word);
@@ -0,0 +1,529 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "decode.h"
+#include "memory.h"
+#include "jit.h"
+#include "trace.h"
+
+#ifdef __x86_64__
+#include <sys/mman.h>
+
+#define CODE_SIZE (1 << 20)   // bytes of generated code before starting over
+#define MAX_BLOCK_INSTS 64    // longest block translated in one go
+#define MAX_INST_BYTES 80     // upper bound on the code for one instruction
+
+/**
+ * A jump at the end of a block whose target was not translated yet.
+ * It goes to the exit stub until the target is translated.
+ */
+struct pending_exit
+{
+    int site;   // offset of the rel32 of the jmp
+    int target; // instruction index it should jump to
+};
+
+struct jit
+{
+    inst_t *program;
+    int no_of_instructions;
+    uint32_t text_base; // guest address of program[0]
+    int trace_level;
+
+    uint8_t *code;    // mmap'd, readable, writable and executable
+    int used;         // bytes of code generated so far
+    uint8_t *exit;    // returns to jit_run with the next pc in eax
+    int blocks_start; // offset of the first block, after entry and exit
+    uint8_t **block;  // [instruction index], translated code or NULL
+
+    struct pending_exit *pending;
+    int n_pending;
+    int max_pending;
+};
+
+// entry(code, registers, memory, n_executed) runs code and returns the next pc
+typedef int (*entry_t)(uint8_t *code, int *registers, memory_t *memory, long *n_executed);
+
+/************** BEGIN EMITTERS ***************/
+/*
+ * Generated code keeps the address of the guest registers in rbx, guest
+ * memory in r12 and the executed instruction counter in r13. All three are
+ * callee saved, so the memory helpers can be called directly.
+ */
+static void emit(jit_t *jit, const uint8_t *bytes, int n)
+{
+    memcpy(jit->code + jit->used, bytes, n);
+    jit->used += n;
+}
+
+static void emit_byte(jit_t *jit, uint8_t b)
+{
+    jit->code[jit->used++] = b;
+}
+
+static void emit_imm32(jit_t *jit, uint32_t imm)
+{
+    memcpy(jit->code + jit->used, &imm, 4);
+    jit->used += 4;
+}
+
+static void emit_imm64(jit_t *jit, uint64_t imm)
+{
+    memcpy(jit->code + jit->used, &imm, 8);
+    jit->used += 8;
+}
+
+/**
+ * <op> <reg>, [rbx + 4 * guest_reg], or the reverse for stores
+ * modrm_reg is the host register number shifted into the reg field
+ */
+static void emit_guest_reg(jit_t *jit, uint8_t opcode, uint8_t modrm_reg, int guest_reg)
+{
+    uint8_t bytes[] = {opcode, 0x43 | modrm_reg, 4 * guest_reg};
+    emit(jit, bytes, 3);
+}
+
+#define EAX (0 << 3)
+#define ECX (1 << 3)
+#define EDX (2 << 3)
+#define ESI (6 << 3)
+#define LOAD 0x8B  // mov reg, [mem]
+#define STORE 0x89 // mov [mem], reg
+
+/**
+ * call <fn>, through rax
+ */
+static void emit_call(jit_t *jit, void *fn)
+{
+    emit(jit, (uint8_t[]){0x48, 0xB8}, 2); // mov rax, imm64
+    emit_imm64(jit, (uint64_t)(uintptr_t)fn);
+    emit(jit, (uint8_t[]){0xFF, 0xD0}, 2); // call rax
+}
+
+/**
+ * trace_inst(index)
+ */
+static void emit_trace(jit_t *jit, int index)
+{
+    emit_byte(jit, 0xBF); // mov edi, imm32
+    emit_imm32(jit, index);
+    emit_call(jit, (void *)trace_inst);
+}
+
+/**
+ * Sets up the arguments of a memory helper: rdi = memory, esi = address
+ */
+static void emit_mem_args(jit_t *jit, inst_t *inst)
+{
+    emit(jit, (uint8_t[]){0x4C, 0x89, 0xE7}, 3); // mov rdi, r12
+    emit_guest_reg(jit, LOAD, ESI, inst->rs1);
+    emit(jit, (uint8_t[]){0x81, 0xC6}, 2); // add esi, imm32
+    emit_imm32(jit, inst->imm);
+}
+
+/**
+ * Leaves the block for target_pc: jumps straight to its code if it is
+ * translated, and to the exit stub otherwise
+ */
+static void emit_exit(jit_t *jit, int target_pc)
+{
+    emit_byte(jit, 0xB8); // mov eax, imm32
+    emit_imm32(jit, target_pc);
+    emit_byte(jit, 0xE9); // jmp rel32
+
+    uint32_t offset = (uint32_t)target_pc - jit->text_base;
+    int target = offset / 4;
+    bool chainable = offset % 4 == 0 && offset / 4 < (uint32_t)jit->no_of_instructions;
+    uint8_t *dest = jit->exit;
+    if (chainable && jit->block[target])
+    {
+        dest = jit->block[target];
+    }
+    else if (chainable)
+    {
+        if (jit->n_pending == jit->max_pending)
+        {
+            jit->max_pending = jit->max_pending ? 2 * jit->max_pending : 64;
+            jit->pending = realloc(jit->pending, jit->max_pending * sizeof(struct pending_exit));
+        }
+        jit->pending[jit->n_pending++] = (struct pending_exit){jit->used, target};
+    }
+    emit_imm32(jit, dest - (jit->code + jit->used + 4));
+}
+/*************** END EMITTERS ****************/
+
+/**
+ * Returns whether the JIT knows how to translate the instruction.
+ * The rarer M extension operations are left to the interpreter.
+ */
+static bool translatable(inst_t *inst)
+{
+    switch (inst->op)
+    {
+    case OP_MULH:
+    case OP_MULHSU:
+    case OP_MULHU:
+    case OP_DIV:
+    case OP_DIVU:
+    case OP_REM:
+    case OP_REMU:
+    case OP_ECALL:
+        return false;
+    default:
+        return true;
+    }
+}
+
+/**
+ * Translates one instruction other than a control transfer. pc is the
+ * address of the instruction.
+ */
+static void translate(jit_t *jit, inst_t *inst, int pc)
+{
+    switch (inst->op)
+    {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_AND:
+    case OP_OR:
+    case OP_XOR:
+    {
+        // <op> eax, [mem]
+        uint8_t opcode = inst->op == OP_ADD ? 0x03 : inst->op == OP_SUB ? 0x2B
+                                                 : inst->op == OP_AND   ? 0x23
+                                                 : inst->op == OP_OR    ? 0x0B
+                                                                        : 0x33;
+        emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+        emit_guest_reg(jit, opcode, EAX, inst->rs2);
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    }
+    case OP_MUL:
+        emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+        emit_byte(jit, 0x0F);
+        emit_guest_reg(jit, 0xAF, EAX, inst->rs2); // imul eax, [mem]
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    case OP_SLT:
+    case OP_SLTU:
+    case OP_SLTI:
+    case OP_SLTIU:
+    {
+        bool imm_f = inst->op == OP_SLTI || inst->op == OP_SLTIU;
+        bool signed_f = inst->op == OP_SLT || inst->op == OP_SLTI;
+        emit(jit, (uint8_t[]){0x31, 0xD2}, 2); // xor edx, edx
+        emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+        if (imm_f)
+        {
+            emit_byte(jit, 0x3D); // cmp eax, imm32
+            emit_imm32(jit, inst->imm);
+        }
+        else
+        {
+            emit_guest_reg(jit, 0x3B, EAX, inst->rs2); // cmp eax, [mem]
+        }
+        emit(jit, (uint8_t[]){0x0F, signed_f ? 0x9C : 0x92, 0xC2}, 3); // setl/setb dl
+        emit_guest_reg(jit, STORE, EDX, inst->rd);
+        break;
+    }
+    case OP_SLL:
+    case OP_SRL:
+    case OP_SRA:
+    {
+        // x86 masks 32 bit shift counts to 5 bits, as RISC-V does
+        uint8_t modrm = inst->op == OP_SLL ? 0xE0 : inst->op == OP_SRL ? 0xE8 : 0xF8;
+        emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+        emit_guest_reg(jit, LOAD, ECX, inst->rs2);
+        emit(jit, (uint8_t[]){0xD3, modrm}, 2); // shl/shr/sar eax, cl
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    }
+    case OP_SLLI:
+    case OP_SRLI:
+    case OP_SRAI:
+    {
+        uint8_t modrm = inst->op == OP_SLLI ? 0xE0 : inst->op == OP_SRLI ? 0xE8 : 0xF8;
+        emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+        emit(jit, (uint8_t[]){0xC1, modrm, inst->imm & 0x1F}, 3); // shl/shr/sar eax, imm8
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    }
+    case OP_ADDI:
+    case OP_ANDI:
+    case OP_ORI:
+    case OP_XORI:
+    {
+        // <op> eax, imm32
+        uint8_t opcode = inst->op == OP_ADDI ? 0x05 : inst->op == OP_ANDI ? 0x25
+                                                  : inst->op == OP_ORI    ? 0x0D
+                                                                          : 0x35;
+        emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+        emit_byte(jit, opcode);
+        emit_imm32(jit, inst->imm);
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    }
+    case OP_LW:
+        emit_mem_args(jit, inst);
+        emit_call(jit, (void *)mem_read_word);
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    case OP_LH:
+    case OP_LHU:
+        emit_mem_args(jit, inst);
+        emit_call(jit, (void *)mem_read_half);
+        emit(jit, (uint8_t[]){0x0F, inst->op == OP_LH ? 0xBF : 0xB7, 0xC0}, 3); // movsx/movzx eax, ax
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    case OP_LB:
+    case OP_LBU:
+        emit_mem_args(jit, inst);
+        emit_call(jit, (void *)mem_read_byte);
+        emit(jit, (uint8_t[]){0x0F, inst->op == OP_LB ? 0xBE : 0xB6, 0xC0}, 3); // movsx/movzx eax, al
+        emit_guest_reg(jit, STORE, EAX, inst->rd);
+        break;
+    case OP_SW:
+    case OP_SH:
+    case OP_SB:
+        emit_mem_args(jit, inst);
+        emit_guest_reg(jit, LOAD, EDX, inst->rd);
+        emit_call(jit, inst->op == OP_SW ? (void *)mem_write_word : inst->op == OP_SH ? (void *)mem_write_half
+                                                                                      : (void *)mem_write_byte);
+        break;
+    case OP_LUI:
+    case OP_AUIPC:
+        // both are constants once the pc is known
+        emit(jit, (uint8_t[]){0xC7, 0x43, 4 * inst->rd}, 3); // mov dword [mem], imm32
+        emit_imm32(jit, inst->op == OP_LUI ? inst->imm : pc + inst->imm);
+        break;
+    }
+}
+
+/**
+ * Translates a conditional branch at pc, which ends its block
+ */
+static void translate_branch(jit_t *jit, inst_t *inst, int pc)
+{
+    // jcc rel32 with the opposite condition, to the not taken path
+    uint8_t not_taken_cc[NO_OF_OPCODES] = {
+        [OP_BEQ] = 0x85, [OP_BNE] = 0x84, [OP_BLT] = 0x8D,
+        [OP_BGE] = 0x8C, [OP_BLTU] = 0x83, [OP_BGEU] = 0x82};
+
+    emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+    emit_guest_reg(jit, 0x3B, EAX, inst->rs2); // cmp eax, [mem]
+    emit(jit, (uint8_t[]){0x0F, not_taken_cc[inst->op]}, 2);
+    int not_taken_site = jit->used;
+    emit_imm32(jit, 0);
+    if (is_traced(inst->op, jit->trace_level))
+    {
+        emit_call(jit, (void *)trace_taken);
+    }
+    emit_exit(jit, pc + inst->imm);
+    int not_taken = jit->used - (not_taken_site + 4);
+    memcpy(jit->code + not_taken_site, &not_taken, 4);
+    emit_exit(jit, pc + 4);
+}
+
+/**
+ * Translates a jal or jalr at pc, which ends its block
+ */
+static void translate_jump(jit_t *jit, inst_t *inst, int pc)
+{
+    if (inst->op == OP_JAL)
+    {
+        if (inst->rd)
+        {
+            emit(jit, (uint8_t[]){0xC7, 0x43, 4 * inst->rd}, 3); // mov dword [mem], imm32
+            emit_imm32(jit, pc + 4);
+        }
+        emit_exit(jit, pc + inst->imm);
+        return;
+    }
+
+    // the target is only known at run time, so leave through the exit stub
+    emit_guest_reg(jit, LOAD, EAX, inst->rs1);
+    emit_byte(jit, 0x05); // add eax, imm32
+    emit_imm32(jit, inst->imm);
+    emit(jit, (uint8_t[]){0x83, 0xE0, 0xFE}, 3); // and eax, ~1
+    if (inst->rd)
+    {
+        emit(jit, (uint8_t[]){0xC7, 0x43, 4 * inst->rd}, 3); // mov dword [mem], imm32
+        emit_imm32(jit, pc + 4);
+    }
+    emit_byte(jit, 0xE9); // jmp rel32
+    emit_imm32(jit, jit->exit - (jit->code + jit->used + 4));
+}
+
+/**
+ * Throws away every translation, for when the code buffer is full
+ */
+static void flush(jit_t *jit)
+{
+    memset(jit->block, 0, jit->no_of_instructions * sizeof(uint8_t *));
+    jit->n_pending = 0;
+    jit->used = jit->blocks_start;
+}
+
+/**
+ * Translates the basic block starting at index. It ends after a branch or
+ * jump, before an instruction that cannot be translated, or at the end of
+ * the program.
+ */
+static uint8_t *translate_block(jit_t *jit, int index)
+{
+    if (jit->used + MAX_BLOCK_INSTS * MAX_INST_BYTES > CODE_SIZE)
+    {
+        flush(jit);
+    }
+
+    uint8_t *start = jit->code + jit->used;
+    jit->block[index] = start;
+
+    // add qword [r13], <instructions in block>, patched once known
+    emit(jit, (uint8_t[]){0x49, 0x81, 0x45, 0x00}, 4);
+    int count_site = jit->used;
+    emit_imm32(jit, 0);
+
+    int i = index;
+    bool ended_f = false;
+    while (!ended_f && i < jit->no_of_instructions && i - index < MAX_BLOCK_INSTS && translatable(&jit->program[i]))
+    {
+        inst_t *inst = &jit->program[i];
+        if (is_traced(inst->op, jit->trace_level))
+        {
+            emit_trace(jit, i);
+        }
+        int pc = jit->text_base + 4 * i++;
+
+        if (is_branch(inst->op))
+        {
+            translate_branch(jit, inst, pc);
+            ended_f = true;
+        }
+        else if (inst->op == OP_JAL || inst->op == OP_JALR)
+        {
+            translate_jump(jit, inst, pc);
+            ended_f = true;
+        }
+        else
+        {
+            translate(jit, inst, pc);
+        }
+    }
+    if (!ended_f)
+    {
+        emit_exit(jit, jit->text_base + 4 * i);
+    }
+
+    int n_insts = i - index;
+    memcpy(jit->code + count_site, &n_insts, 4);
+
+    // chain the blocks that were waiting for this one
+    for (int p = 0; p < jit->n_pending; p++)
+    {
+        if (jit->pending[p].target == index)
+        {
+            int site = jit->pending[p].site;
+            int rel = start - (jit->code + site + 4);
+            memcpy(jit->code + site, &rel, 4);
+            jit->pending[p--] = jit->pending[--jit->n_pending];
+        }
+    }
+    return start;
+}
+
+jit_t *jit_init(inst_t *program, int no_of_instructions, uint32_t text_base, int trace_level)
+{
+    uint8_t *code = mmap(NULL, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    jit_t *jit = calloc(1, sizeof(jit_t));
+    jit->program = program;
+    jit->no_of_instructions = no_of_instructions;
+    jit->text_base = text_base;
+    jit->trace_level = trace_level;
+    jit->code = code;
+    jit->block = calloc(no_of_instructions > 0 ? no_of_instructions : 1, sizeof(uint8_t *));
+
+    // entry: save the pinned registers, load them from the arguments and
+    // jump to the block. With three pushes the stack stays 16 byte aligned
+    // for the calls made by the blocks.
+    emit(jit, (uint8_t[]){
+                  0x53,             // push rbx
+                  0x41, 0x54,       // push r12
+                  0x41, 0x55,       // push r13
+                  0x48, 0x89, 0xF3, // mov rbx, rsi
+                  0x49, 0x89, 0xD4, // mov r12, rdx
+                  0x49, 0x89, 0xCD, // mov r13, rcx
+                  0xFF, 0xE7,       // jmp rdi
+              },
+         16);
+
+    // exit: restore them and return the pc in eax
+    jit->exit = jit->code + jit->used;
+    emit(jit, (uint8_t[]){
+                  0x41, 0x5D, // pop r13
+                  0x41, 0x5C, // pop r12
+                  0x5B,       // pop rbx
+                  0xC3,       // ret
+              },
+         6);
+
+    jit->blocks_start = jit->used;
+    return jit;
+}
+
+void jit_free(jit_t *jit)
+{
+    if (jit == NULL)
+    {
+        return;
+    }
+    munmap(jit->code, CODE_SIZE);
+    free(jit->block);
+    free(jit->pending);
+    free(jit);
+}
+
+bool jit_run(jit_t *jit, int *pc, int *registers, memory_t *memory, long *n_executed)
+{
+    uint32_t offset = (uint32_t)*pc - jit->text_base;
+    int index = offset / 4;
+    if (offset % 4 != 0 || !translatable(&jit->program[index]))
+    {
+        return false;
+    }
+
+    uint8_t *block = jit->block[index];
+    if (block == NULL)
+    {
+        block = translate_block(jit, index);
+    }
+    *pc = ((entry_t)jit->code)(block, registers, memory, n_executed);
+    return true;
+}
+
+#else
+/*
+ * There is only an x86-64 backend. Elsewhere jit_init fails and the
+ * interpreter runs everything.
+ */
+jit_t *jit_init(inst_t *program, int no_of_instructions, uint32_t text_base, int trace_level)
+{
+    return NULL;
+}
+
+void jit_free(jit_t *jit)
+{
+}
+
+bool jit_run(jit_t *jit, int *pc, int *registers, memory_t *memory, long *n_executed)
+{
+    return false;
+}
+#endif
@@ -0,0 +1,43 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+struct inst;
+struct memory;
+
+/**
+ * Type alias for the internal representation of the JIT.
+ * Defined in jit.c:
+ *
+ *     struct jit {
+ *         ...
+ *     }
+ *
+ * The JIT translates basic blocks of the decoded program into x86-64 code,
+ * one block the first time execution reaches it. Guest registers stay in
+ * the registers_t, whose address is pinned in a host register. Blocks jump
+ * straight into each other once both are translated.
+ */
+typedef struct jit jit_t;
+
+/**
+ * Return a pointer to a new JIT for the decoded program, whose first
+ * instruction is at guest address text_base, or NULL if this host cannot
+ * run one. The generated code traces the instructions that trace_level
+ * covers, the same way the interpreter does, and has no tracing in it at
+ * TRACE_OFF.
+ */
+jit_t *jit_init(struct inst *program, int no_of_instructions, uint32_t text_base, int trace_level);
+
+/**
+ * Free a JIT and its code buffer
+ */
+void jit_free(jit_t *jit);
+
+/**
+ * Runs translated code from *pc until it leaves the program or reaches an
+ * instruction the JIT cannot translate, then updates *pc and adds the
+ * number of instructions executed to *n_executed.
+ * Returns false, without running anything, if the instruction at *pc
+ * cannot be translated and must be interpreted instead.
+ */
+bool jit_run(jit_t *jit, int *pc, int *registers, struct memory *memory, long *n_executed);
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode.h"
+#include "memory.h"
+#include "loader.h"
+
+#define EM_RISCV 243
+#define PT_LOAD 1
+#define PF_X 1
+#define MAX_TEXT_SIZE (64 << 20) // bytes of executable segments decoded, 16M instructions
+
+/**
+ * The parts of the ELF32 file and program headers the loader needs
+ */
+struct elf32_header
+{
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+};
+
+struct elf32_phdr
+{
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+};
+
+/**
+ * Reads the whole file into a new buffer
+ */
+static uint8_t *read_file(const char *path, long *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *data = malloc(*size > 0 ? *size : 1);
+    if (fread(data, 1, *size, file) != (size_t)*size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+/**
+ * Decodes the instructions in guest memory from base up to end
+ */
+static void decode_text(memory_t *memory, uint32_t base, uint32_t end, loaded_program_t *out)
+{
+    out->text_base = base;
+    out->no_of_instructions = (end - base) / 4;
+    out->program = calloc(out->no_of_instructions + 1, sizeof(inst_t));
+    for (int i = 0; i < out->no_of_instructions; i++)
+    {
+        decode_word(mem_read_word(memory, base + 4 * i), &out->program[i]);
+    }
+}
+
+static int load_elf(const char *path, const uint8_t *data, long size, memory_t *memory, loaded_program_t *out)
+{
+    struct elf32_header header;
+    if (size < (long)sizeof(header))
+    {
+        fprintf(stderr, "%s: truncated ELF header\n", path);
+        return -1;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    // ELFCLASS32, ELFDATA2LSB, RISC-V
+    if (header.ident[4] != 1 || header.ident[5] != 1 || header.machine != EM_RISCV)
+    {
+        fprintf(stderr, "%s: not a 32 bit little-endian RISC-V ELF file\n", path);
+        return -1;
+    }
+    if (header.phnum > 0 && header.phentsize < sizeof(struct elf32_phdr))
+    {
+        fprintf(stderr, "%s: program headers are too small\n", path);
+        return -1;
+    }
+    if ((long)header.phoff + (long)header.phnum * header.phentsize > size)
+    {
+        fprintf(stderr, "%s: truncated program headers\n", path);
+        return -1;
+    }
+
+    uint32_t text_start = UINT32_MAX;
+    uint32_t text_end = 0;
+    for (int i = 0; i < header.phnum; i++)
+    {
+        struct elf32_phdr phdr;
+        memcpy(&phdr, data + header.phoff + i * header.phentsize, sizeof(phdr));
+        if (phdr.type != PT_LOAD)
+        {
+            continue;
+        }
+        if ((long)phdr.offset + phdr.filesz > size)
+        {
+            fprintf(stderr, "%s: segment %d extends past the end of the file\n", path, i);
+            return -1;
+        }
+        if (phdr.filesz > phdr.memsz)
+        {
+            fprintf(stderr, "%s: segment %d is larger in the file than in memory\n", path, i);
+            return -1;
+        }
+        if ((uint64_t)phdr.vaddr + phdr.memsz > UINT32_MAX)
+        {
+            fprintf(stderr, "%s: segment %d extends past the end of the address space\n", path, i);
+            return -1;
+        }
+
+        // the rest of memsz is .bss, which guest memory already reads as 0
+        mem_write_block(memory, phdr.vaddr, data + phdr.offset, phdr.filesz);
+        if (phdr.flags & PF_X)
+        {
+            if (phdr.vaddr < text_start)
+                text_start = phdr.vaddr;
+            if (phdr.vaddr + phdr.memsz > text_end)
+                text_end = phdr.vaddr + phdr.memsz;
+        }
+    }
+    if (text_start >= text_end)
+    {
+        fprintf(stderr, "%s: no executable segment\n", path);
+        return -1;
+    }
+    if (text_end - text_start > MAX_TEXT_SIZE)
+    {
+        fprintf(stderr, "%s: executable segments span more than %d MB\n", path, MAX_TEXT_SIZE >> 20);
+        return -1;
+    }
+
+    decode_text(memory, text_start, text_end, out);
+    out->entry = header.entry;
+    return 0;
+}
+
+int load_binary(const char *path, memory_t *memory, loaded_program_t *out)
+{
+    long size;
+    uint8_t *data = read_file(path, &size);
+    if (data == NULL)
+    {
+        fprintf(stderr, "%s: cannot read file\n", path);
+        return -1;
+    }
+
+    int result = 0;
+    if (size >= 4 && memcmp(data, "\x7f" "ELF", 4) == 0)
+    {
+        result = load_elf(path, data, size, memory, out);
+    }
+    else
+    {
+        mem_write_block(memory, 0, data, size);
+        decode_text(memory, 0, size & ~3L, out);
+        out->entry = 0;
+    }
+
+    free(data);
+    return result;
+}
@@ -0,0 +1,27 @@
+#include <stdint.h>
+
+struct inst;
+struct memory;
+
+/**
+ * A program loaded from a binary, ready for init_decoded()
+ */
+struct loaded_program
+{
+    struct inst *program;   // decoded text, with one spare entry at the end
+    int no_of_instructions;
+    uint32_t text_base;     // guest address of program[0]
+    uint32_t entry;         // guest address execution starts at
+};
+typedef struct loaded_program loaded_program_t;
+
+/**
+ * Loads a static ELF32 RISC-V executable, or a raw RV32 binary if the file
+ * does not start with the ELF magic. Every loadable segment (the whole file
+ * for a raw binary) is copied into memory, and the executable ones are
+ * decoded into out->program. A raw binary is loaded at, and starts
+ * executing from, address 0. The program ends at an exit system call
+ * (ecall with a7 = 93) or when it jumps out of the executable code.
+ * Returns 0 on success, or -1 after printing why the file cannot be loaded.
+ */
+int load_binary(const char *path, struct memory *memory, loaded_program_t *out);
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+
+#define L2_BITS 10
+#define L1_BITS (32 - PAGE_BITS - L2_BITS)
+
+struct memory
+{
+    // l1[top bits] points to a table of L2 page pointers, NULL until used
+    uint8_t **l1[1 << L1_BITS];
+    int n_pages;
+};
+
+memory_t *mem_init()
+{
+    return calloc(1, sizeof(memory_t));
+}
+
+memory_t *mem_clone(memory_t *mem)
+{
+    memory_t *copy = mem_init();
+    for (int i = 0; i < (1 << L1_BITS); i++)
+    {
+        if (mem->l1[i] == NULL)
+        {
+            continue;
+        }
+        copy->l1[i] = calloc(1 << L2_BITS, sizeof(uint8_t *));
+        for (int j = 0; j < (1 << L2_BITS); j++)
+        {
+            if (mem->l1[i][j])
+            {
+                copy->l1[i][j] = malloc(PAGE_SIZE);
+                memcpy(copy->l1[i][j], mem->l1[i][j], PAGE_SIZE);
+            }
+        }
+    }
+    copy->n_pages = mem->n_pages;
+    return copy;
+}
+
+void mem_free(memory_t *mem)
+{
+    for (int i = 0; i < (1 << L1_BITS); i++)
+    {
+        if (mem->l1[i] == NULL)
+        {
+            continue;
+        }
+        for (int j = 0; j < (1 << L2_BITS); j++)
+        {
+            free(mem->l1[i][j]);
+        }
+        free(mem->l1[i]);
+    }
+    free(mem);
+}
+
+/**
+ * Return the page holding addr. If it does not exist yet, allocate it
+ * when alloc is set and return NULL otherwise.
+ */
+static uint8_t *get_page(memory_t *mem, uint32_t addr, int alloc)
+{
+    uint8_t ***l2 = &mem->l1[addr >> (PAGE_BITS + L2_BITS)];
+    if (*l2 == NULL)
+    {
+        if (!alloc)
+        {
+            return NULL;
+        }
+        *l2 = calloc(1 << L2_BITS, sizeof(uint8_t *));
+    }
+
+    uint8_t **page = &(*l2)[(addr >> PAGE_BITS) & ((1 << L2_BITS) - 1)];
+    if (*page == NULL && alloc)
+    {
+        *page = calloc(PAGE_SIZE, 1);
+        mem->n_pages++;
+    }
+    return *page;
+}
+
+/**
+ * Copies n bytes of guest memory starting at addr into the host buffer,
+ * in guest (little-endian) order
+ */
+static void read_bytes(memory_t *mem, uint32_t addr, uint8_t *dst, int n)
+{
+    uint32_t offset = addr & (PAGE_SIZE - 1);
+    if (offset + n <= PAGE_SIZE)
+    {
+        uint8_t *page = get_page(mem, addr, 0);
+        if (page)
+            memcpy(dst, page + offset, n);
+        else
+            memset(dst, 0, n);
+        return;
+    }
+
+    // straddles two pages (or wraps around the address space)
+    for (int i = 0; i < n; i++)
+    {
+        dst[i] = mem_read_byte(mem, addr + i);
+    }
+}
+
+static void write_bytes(memory_t *mem, uint32_t addr, const uint8_t *src, int n)
+{
+    uint32_t offset = addr & (PAGE_SIZE - 1);
+    if (offset + n <= PAGE_SIZE)
+    {
+        memcpy(get_page(mem, addr, 1) + offset, src, n);
+        return;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        mem_write_byte(mem, addr + i, src[i]);
+    }
+}
+
+uint32_t mem_read_word(memory_t *mem, uint32_t addr)
+{
+    uint8_t b[4];
+    read_bytes(mem, addr, b, 4);
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+uint16_t mem_read_half(memory_t *mem, uint32_t addr)
+{
+    uint8_t b[2];
+    read_bytes(mem, addr, b, 2);
+    return b[0] | (b[1] << 8);
+}
+
+uint8_t mem_read_byte(memory_t *mem, uint32_t addr)
+{
+    uint8_t *page = get_page(mem, addr, 0);
+    return page ? page[addr & (PAGE_SIZE - 1)] : 0;
+}
+
+void mem_write_word(memory_t *mem, uint32_t addr, uint32_t value)
+{
+    uint8_t b[4] = {value, value >> 8, value >> 16, value >> 24};
+    write_bytes(mem, addr, b, 4);
+}
+
+void mem_write_half(memory_t *mem, uint32_t addr, uint16_t value)
+{
+    uint8_t b[2] = {value, value >> 8};
+    write_bytes(mem, addr, b, 2);
+}
+
+void mem_write_byte(memory_t *mem, uint32_t addr, uint8_t value)
+{
+    get_page(mem, addr, 1)[addr & (PAGE_SIZE - 1)] = value;
+}
+
+void mem_write_block(memory_t *mem, uint32_t addr, const uint8_t *src, uint32_t size)
+{
+    while (size > 0)
+    {
+        // up to the end of the page addr is in
+        uint32_t chunk = PAGE_SIZE - (addr & (PAGE_SIZE - 1));
+        if (chunk > size)
+            chunk = size;
+        memcpy(get_page(mem, addr, 1) + (addr & (PAGE_SIZE - 1)), src, chunk);
+        addr += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+}
+
+int mem_pages(memory_t *mem)
+{
+    return mem->n_pages;
+}
@@ -0,0 +1,57 @@
+#include <stdint.h>
+
+/**
+ * Type alias for the internal representation of guest memory.
+ * Defined in memory.c:
+ *
+ *     struct memory {
+ *         ...
+ *     }
+ *
+ * Guest memory is a sparse two-level page table over the 32 bit address
+ * space. Pages are 4KB and allocated the first time they are written, so
+ * untouched memory reads as 0 and costs nothing.
+ */
+typedef struct memory memory_t;
+
+#define PAGE_BITS 12
+#define PAGE_SIZE (1 << PAGE_BITS)
+
+/**
+ * Return a pointer to new, zeroed guest memory
+ */
+memory_t *mem_init();
+
+/**
+ * Return a pointer to a copy of the given guest memory
+ */
+memory_t *mem_clone(memory_t *mem);
+
+/**
+ * Free guest memory and every page allocated in it
+ */
+void mem_free(memory_t *mem);
+
+/**
+ * Little-endian loads. Accesses need not be aligned.
+ */
+uint32_t mem_read_word(memory_t *mem, uint32_t addr);
+uint16_t mem_read_half(memory_t *mem, uint32_t addr);
+uint8_t mem_read_byte(memory_t *mem, uint32_t addr);
+
+/**
+ * Little-endian stores. Accesses need not be aligned.
+ */
+void mem_write_word(memory_t *mem, uint32_t addr, uint32_t value);
+void mem_write_half(memory_t *mem, uint32_t addr, uint16_t value);
+void mem_write_byte(memory_t *mem, uint32_t addr, uint8_t value);
+
+/**
+ * Copies size bytes from the host buffer to guest memory at addr
+ */
+void mem_write_block(memory_t *mem, uint32_t addr, const uint8_t *src, uint32_t size);
+
+/**
+ * Returns the number of pages allocated so far.
+ */
+int mem_pages(memory_t *mem);
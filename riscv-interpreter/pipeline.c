@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include "decode.h"
+#include "pipeline.h"
+
+#define MISPREDICT_PENALTY 2 // branches resolve in EX, after IF and ID fetched the wrong path
+#define TAKEN_PENALTY 1      // there is no branch target buffer, so predicted taken targets are known in ID
+#define JAL_PENALTY 1        // jal targets are known in ID
+#define JALR_PENALTY 2       // jalr targets are known in EX
+#define DRAIN_CYCLES 3       // EX, MEM and WB of the last instruction after its ID
+
+/**
+ * Why the pipeline did not start an instruction every cycle
+ */
+enum stall
+{
+    STALL_LOAD_USE,
+    STALL_RAW,
+    STALL_MISPREDICT,
+    STALL_TAKEN,
+    STALL_JUMP,
+    NO_OF_STALLS
+};
+
+static const char *stall_names[NO_OF_STALLS] = {"load-use", "RAW", "branch mispredict", "taken branch", "jump"};
+static const char *predictor_names[] = {[PREDICT_NOT_TAKEN] = "static not-taken",
+                                        [PREDICT_BIMODAL] = "bimodal",
+                                        [PREDICT_GSHARE] = "gshare"};
+
+struct pipeline
+{
+    int predictor;
+    int table_bits;
+    bool forwarding_f;
+    uint8_t *counters; // 2 bit saturating counters, taken from 2 up
+    uint32_t history;  // outcomes of the latest branches, newest in bit 0
+
+    long instructions;
+    long id_cycle;       // cycle the latest instruction was in ID
+    int bubbles;         // cycles the next instruction loses to the latest one's control flow
+    long ready[32];      // first cycle an instruction in ID can use each register
+    bool loaded[32];     // whether a register's latest value comes from a load
+    long stalls[NO_OF_STALLS];
+    long branches;
+    long mispredicts;
+};
+
+/************** BEGIN HELPER FUNCTIONS ***************/
+static bool is_load(int op)
+{
+    return op >= OP_LW && op <= OP_LBU;
+}
+
+static bool is_store(int op)
+{
+    return op >= OP_SW && op <= OP_SB;
+}
+
+/**
+ * Returns whether the instruction reads rs1, and rs2 for reads_rs2
+ */
+static bool reads_rs1(int op)
+{
+    return op != OP_NOP && op != OP_LUI && op != OP_AUIPC && op != OP_JAL && op != OP_ECALL;
+}
+
+static bool reads_rs2(int op)
+{
+    return (op >= OP_ADD && op <= OP_REMU) || is_branch(op);
+}
+
+/**
+ * Returns whether the instruction writes rd. Writes to x0 are decoded as
+ * OP_NOP, so rd is never x0 here.
+ */
+static bool writes_rd(int op)
+{
+    return op != OP_NOP && op != OP_ECALL && !is_store(op) && !is_branch(op);
+}
+
+/**
+ * Predicts the branch at pc and trains the predictor with the outcome.
+ * Returns whether the prediction was right.
+ */
+static bool predict(pipeline_t *pipeline, uint32_t pc, bool taken)
+{
+    if (pipeline->predictor == PREDICT_NOT_TAKEN)
+    {
+        return !taken;
+    }
+
+    uint32_t mask = (1u << pipeline->table_bits) - 1;
+    uint32_t index = pc >> 2;
+    if (pipeline->predictor == PREDICT_GSHARE)
+    {
+        index ^= pipeline->history;
+        pipeline->history = (pipeline->history << 1) | taken;
+    }
+    uint8_t *counter = &pipeline->counters[index & mask];
+    bool predicted = *counter >= 2;
+    if (taken && *counter < 3)
+        (*counter)++;
+    else if (!taken && *counter > 0)
+        (*counter)--;
+    return predicted == taken;
+}
+
+/**
+ * Delays the instruction in ID until the register is available, charging
+ * the stall to whatever produced it
+ */
+static void wait_for(pipeline_t *pipeline, int reg, long *id_cycle, int *cause)
+{
+    if (pipeline->ready[reg] > *id_cycle)
+    {
+        *id_cycle = pipeline->ready[reg];
+        *cause = pipeline->loaded[reg] && pipeline->forwarding_f ? STALL_LOAD_USE : STALL_RAW;
+    }
+}
+/*************** END HELPER FUNCTIONS ****************/
+
+pipeline_t *pipeline_init(int predictor, int table_bits, bool forwarding_f)
+{
+    pipeline_t *pipeline = calloc(1, sizeof(pipeline_t));
+    pipeline->predictor = predictor;
+    pipeline->table_bits = table_bits;
+    pipeline->forwarding_f = forwarding_f;
+    pipeline->counters = malloc(1 << table_bits);
+    // every counter starts weakly not taken
+    for (int i = 0; i < 1 << table_bits; i++)
+    {
+        pipeline->counters[i] = 1;
+    }
+    return pipeline;
+}
+
+void pipeline_free(pipeline_t *pipeline)
+{
+    if (pipeline == NULL)
+        return;
+    free(pipeline->counters);
+    free(pipeline);
+}
+
+void pipeline_step(pipeline_t *pipeline, inst_t *inst, uint32_t pc, bool taken)
+{
+    int op = inst->op;
+
+    // without hazards each instruction reaches ID the cycle after the last
+    // (the first is in ID in cycle 1), plus any bubbles the last one caused,
+    // which were already charged when it resolved
+    long expected = pipeline->instructions ? pipeline->id_cycle + 1 + pipeline->bubbles : 1;
+    pipeline->bubbles = 0;
+
+    long id_cycle = expected;
+    int cause = STALL_RAW;
+    if (reads_rs1(op))
+    {
+        wait_for(pipeline, inst->rs1, &id_cycle, &cause);
+    }
+    if (reads_rs2(op))
+    {
+        wait_for(pipeline, inst->rs2, &id_cycle, &cause);
+    }
+    if (is_store(op))
+    {
+        // with forwarding the stored value is only needed in MEM, in time
+        // even when it was just loaded
+        long ready = pipeline->ready[inst->rd] - (pipeline->forwarding_f && pipeline->loaded[inst->rd] ? 1 : 0);
+        if (ready > id_cycle)
+        {
+            id_cycle = ready;
+            cause = STALL_RAW;
+        }
+    }
+    pipeline->stalls[cause] += id_cycle - expected;
+    pipeline->id_cycle = id_cycle;
+    pipeline->instructions++;
+
+    if (writes_rd(op) && inst->rd)
+    {
+        // forwarded from the end of EX, or of MEM for loads; otherwise
+        // written in WB and read back in ID in the same cycle
+        if (!pipeline->forwarding_f)
+            pipeline->ready[inst->rd] = id_cycle + 3;
+        else
+            pipeline->ready[inst->rd] = id_cycle + (is_load(op) ? 2 : 1);
+        pipeline->loaded[inst->rd] = is_load(op);
+    }
+
+    if (is_branch(op))
+    {
+        pipeline->branches++;
+        if (!predict(pipeline, pc, taken))
+        {
+            pipeline->mispredicts++;
+            pipeline->bubbles = MISPREDICT_PENALTY;
+            pipeline->stalls[STALL_MISPREDICT] += MISPREDICT_PENALTY;
+        }
+        else if (taken)
+        {
+            // IF fetched the fall through while ID computed the target
+            pipeline->bubbles = TAKEN_PENALTY;
+            pipeline->stalls[STALL_TAKEN] += TAKEN_PENALTY;
+        }
+    }
+    else if (op == OP_JAL || op == OP_JALR)
+    {
+        pipeline->bubbles = op == OP_JAL ? JAL_PENALTY : JALR_PENALTY;
+        pipeline->stalls[STALL_JUMP] += pipeline->bubbles;
+    }
+}
+
+void pipeline_print(pipeline_t *pipeline, FILE *out)
+{
+    long instructions = pipeline->instructions;
+    long cycles = instructions ? pipeline->id_cycle + DRAIN_CYCLES + 1 : 0;
+    fprintf(out, "Pipeline: 5-stage in-order, %s, %s predictor", pipeline->forwarding_f ? "forwarding" : "no forwarding",
+            predictor_names[pipeline->predictor]);
+    if (pipeline->predictor != PREDICT_NOT_TAKEN)
+    {
+        fprintf(out, " (%d counters)", 1 << pipeline->table_bits);
+    }
+    fprintf(out, ", no BTB\n");
+    fprintf(out, "  %-18s  %12ld\n", "instructions", instructions);
+    fprintf(out, "  %-18s  %12ld\n", "cycles", cycles);
+    fprintf(out, "  %-18s  %12.3f\n", "CPI", instructions ? (double)cycles / instructions : 0.0);
+    fprintf(out, "  stall cycles:\n");
+    for (int s = 0; s < NO_OF_STALLS; s++)
+    {
+        fprintf(out, "    %-16s  %12ld  %5.1f%%\n", stall_names[s], pipeline->stalls[s],
+                cycles ? 100.0 * pipeline->stalls[s] / cycles : 0.0);
+    }
+    fprintf(out, "  %-18s  %12ld\n", "branches", pipeline->branches);
+    fprintf(out, "  %-18s  %12ld  %5.1f%%\n", "mispredicted", pipeline->mispredicts,
+            pipeline->branches ? 100.0 * pipeline->mispredicts / pipeline->branches : 0.0);
+}
@@ -0,0 +1,57 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct inst;
+
+/**
+ * Type alias for the internal representation of the timing model.
+ * Defined in pipeline.c:
+ *
+ *     struct pipeline {
+ *         ...
+ *     }
+ *
+ * The timing model estimates how many cycles the instructions executed
+ * would take on a classic in-order IF/ID/EX/MEM/WB pipeline. Branches and
+ * jalr are resolved in EX and jal in ID. There is no branch target buffer,
+ * so a branch predicted taken still loses a cycle while ID computes its
+ * target. With forwarding, results go
+ * straight from EX and MEM to the instructions that need them, so only
+ * a load followed by a use of its result stalls; without it, every
+ * instruction waits in ID for its operands to be written back.
+ */
+typedef struct pipeline pipeline_t;
+
+/**
+ * How the pipeline predicts conditional branches in IF
+ */
+enum predictor
+{
+    PREDICT_NOT_TAKEN, // statically not taken
+    PREDICT_BIMODAL,   // a 2 bit counter per branch address
+    PREDICT_GSHARE     // 2 bit counters indexed by the address xor the global history
+};
+
+/**
+ * Return a pointer to a new timing model with the given predictor, whose
+ * table has 2^table_bits counters
+ */
+pipeline_t *pipeline_init(int predictor, int table_bits, bool forwarding_f);
+
+/**
+ * Free a timing model
+ */
+void pipeline_free(pipeline_t *pipeline);
+
+/**
+ * Adds the instruction at pc, which has just executed, to the timing.
+ * taken tells whether it was a conditional branch that was taken.
+ */
+void pipeline_step(pipeline_t *pipeline, struct inst *inst, uint32_t pc, bool taken);
+
+/**
+ * Prints the cycles, CPI, stall cycles by cause and the branch
+ * misprediction rate
+ */
+void pipeline_print(pipeline_t *pipeline, FILE *out);
@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "decode.h"
+#include "profile.h"
+
+#define PROFILE_TOP 10 // rows printed in each of the hottest lists
+
+/**
+ * Classes of operations that the profile totals instructions by
+ */
+enum op_class
+{
+    CLASS_ALU,
+    CLASS_MULDIV,
+    CLASS_LOAD,
+    CLASS_STORE,
+    CLASS_BRANCH,
+    CLASS_JUMP,
+    NO_OF_CLASSES
+};
+
+static const char *class_names[NO_OF_CLASSES] = {"alu", "mul/div", "load", "store", "branch", "jump"};
+
+struct profile
+{
+    inst_t *program;
+    int no_of_instructions;
+    uint32_t text_base;
+
+    long *counts;    // times each instruction executed
+    long *taken;     // times each branch was taken
+    bool *leaders;   // instructions that start a basic block
+    long *entries;   // times each block was entered, by its first instruction
+    double *ns;      // host time spent in each block, by its first instruction
+
+    bool running_f;  // a block has been entered since the start
+    uint32_t last_index;
+    uint32_t block;  // first instruction of the block being executed
+    struct timespec block_start;
+    struct timespec start;
+    double total_ns;
+    double timer_ns; // what reading the clock costs, taken off every block
+};
+
+/**
+ * A row of one of the hottest lists: a block or a loop
+ */
+struct hot_range
+{
+    uint32_t first;
+    uint32_t last;
+    long count;        // entries of a block, iterations of a loop
+    long instructions;
+    double ns;
+};
+
+/************** BEGIN HELPER FUNCTIONS ***************/
+static double elapsed_ns(struct timespec *t0, struct timespec *t1)
+{
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+static int op_class(int op)
+{
+    if (op >= OP_MUL && op <= OP_REMU)
+        return CLASS_MULDIV;
+    if (op >= OP_LW && op <= OP_LBU)
+        return CLASS_LOAD;
+    if (op >= OP_SW && op <= OP_SB)
+        return CLASS_STORE;
+    if (is_branch(op))
+        return CLASS_BRANCH;
+    if (op == OP_JAL || op == OP_JALR)
+        return CLASS_JUMP;
+    return CLASS_ALU;
+}
+
+/**
+ * Returns the index of the instruction a branch or jal at index jumps to,
+ * or -1 if it is outside the program
+ */
+static long jump_target(profile_t *profile, uint32_t index)
+{
+    int imm = profile->program[index].imm;
+    long target = (long)index + imm / 4;
+    if (imm % 4 != 0 || target < 0 || target >= profile->no_of_instructions)
+        return -1;
+    return target;
+}
+
+/**
+ * Returns the average time a range took per guest instruction, without
+ * going below zero when the timer overhead estimate is too high
+ */
+static double ns_per_instruction(struct hot_range *range)
+{
+    if (range->instructions == 0 || range->ns <= 0)
+        return 0;
+    return range->ns / range->instructions;
+}
+
+static int compare_instructions(const void *a, const void *b)
+{
+    long x = ((const struct hot_range *)a)->instructions;
+    long y = ((const struct hot_range *)b)->instructions;
+    return (x < y) - (x > y);
+}
+
+static int compare_count(const void *a, const void *b)
+{
+    long x = ((const struct hot_range *)a)->count;
+    long y = ((const struct hot_range *)b)->count;
+    return (x < y) - (x > y);
+}
+/*************** END HELPER FUNCTIONS ****************/
+
+profile_t *profile_init(inst_t *program, int no_of_instructions, uint32_t text_base)
+{
+    profile_t *profile = calloc(1, sizeof(profile_t));
+    profile->program = program;
+    profile->no_of_instructions = no_of_instructions;
+    profile->text_base = text_base;
+    profile->counts = calloc(no_of_instructions + 1, sizeof(long));
+    profile->taken = calloc(no_of_instructions + 1, sizeof(long));
+    profile->leaders = calloc(no_of_instructions + 1, sizeof(bool));
+    profile->entries = calloc(no_of_instructions + 1, sizeof(long));
+    profile->ns = calloc(no_of_instructions + 1, sizeof(double));
+
+    // blocks start at the top, at jump targets and after every jump
+    profile->leaders[0] = true;
+    for (int i = 0; i < no_of_instructions; i++)
+    {
+        int op = program[i].op;
+        if (is_branch(op) || op == OP_JAL || op == OP_JALR)
+        {
+            profile->leaders[i + 1] = true;
+        }
+        if ((is_branch(op) || op == OP_JAL) && jump_target(profile, i) >= 0)
+        {
+            profile->leaders[jump_target(profile, i)] = true;
+        }
+    }
+
+    // every block entry reads the clock once, which the block is charged for
+    struct timespec t0, t1, t;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < 1000; i++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    profile->timer_ns = elapsed_ns(&t0, &t1) / 1000;
+    return profile;
+}
+
+void profile_free(profile_t *profile)
+{
+    if (profile == NULL)
+        return;
+    free(profile->counts);
+    free(profile->taken);
+    free(profile->leaders);
+    free(profile->entries);
+    free(profile->ns);
+    free(profile);
+}
+
+/**
+ * Charges the time since the current block was entered to it, and starts
+ * timing the block at index
+ */
+static void enter_block(profile_t *profile, uint32_t index)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (profile->running_f)
+    {
+        profile->ns[profile->block] += elapsed_ns(&profile->block_start, &now) - profile->timer_ns;
+    }
+    else
+    {
+        profile->start = now;
+        profile->running_f = true;
+    }
+    // jalr can enter a block anywhere, which then starts a block of its own
+    profile->leaders[index] = true;
+    profile->entries[index]++;
+    profile->block = index;
+    profile->block_start = now;
+}
+
+void profile_step(profile_t *profile, uint32_t index)
+{
+    profile->counts[index]++;
+    if (!profile->running_f || profile->leaders[index] || index != profile->last_index + 1)
+    {
+        enter_block(profile, index);
+    }
+    profile->last_index = index;
+}
+
+void profile_branch(profile_t *profile, uint32_t index, bool taken)
+{
+    if (taken)
+    {
+        profile->taken[index]++;
+    }
+}
+
+void profile_stop(profile_t *profile)
+{
+    if (!profile->running_f)
+        return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    profile->ns[profile->block] += elapsed_ns(&profile->block_start, &now) - profile->timer_ns;
+    profile->total_ns += elapsed_ns(&profile->start, &now);
+    profile->running_f = false;
+}
+
+/**
+ * Sums the instructions executed and time spent from first to last
+ */
+static void sum_range(profile_t *profile, struct hot_range *range)
+{
+    range->instructions = 0;
+    range->ns = 0;
+    for (uint32_t i = range->first; i <= range->last; i++)
+    {
+        range->instructions += profile->counts[i];
+        range->ns += profile->ns[i];
+    }
+}
+
+static void print_ranges(profile_t *profile, FILE *out, struct hot_range *ranges, int n, long total,
+                         const char *count_name)
+{
+    fprintf(out, "  %-10s  %-10s  %10s  %12s  %6s  %8s\n", "first pc", "last pc", count_name, "instructions",
+            "%", "ns/inst");
+    for (int i = 0; i < n && i < PROFILE_TOP; i++)
+    {
+        struct hot_range *range = &ranges[i];
+        fprintf(out, "  0x%08x  0x%08x  %10ld  %12ld  %5.1f%%  %8.2f\n", profile->text_base + 4 * range->first,
+                profile->text_base + 4 * range->last, range->count, range->instructions,
+                100.0 * range->instructions / total, ns_per_instruction(range));
+    }
+}
+
+void profile_print(profile_t *profile, FILE *out)
+{
+    int n = profile->no_of_instructions;
+    long total = 0;
+    long classes[NO_OF_CLASSES] = {0};
+    for (int i = 0; i < n; i++)
+    {
+        total += profile->counts[i];
+        classes[op_class(profile->program[i].op)] += profile->counts[i];
+    }
+    if (total == 0)
+    {
+        fprintf(out, "Profile: no instructions executed\n");
+        return;
+    }
+
+    fprintf(out, "Profile: %ld instructions in %.3f ms, %.2f ns/instruction\n", total, profile->total_ns / 1e6,
+            profile->total_ns / total);
+    fprintf(out, "\nInstructions by class:\n");
+    for (int c = 0; c < NO_OF_CLASSES; c++)
+    {
+        fprintf(out, "  %-8s  %12ld  %5.1f%%\n", class_names[c], classes[c], 100.0 * classes[c] / total);
+    }
+
+    struct hot_range *ranges = calloc(n, sizeof(struct hot_range));
+
+    // basic blocks run from a leader up to the next one
+    int n_ranges = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (!profile->leaders[i] || profile->entries[i] == 0)
+            continue;
+        struct hot_range *block = &ranges[n_ranges++];
+        block->first = i;
+        block->last = i;
+        while ((int)block->last + 1 < n && !profile->leaders[block->last + 1])
+            block->last++;
+        block->count = profile->entries[i];
+        sum_range(profile, block);
+    }
+    qsort(ranges, n_ranges, sizeof(struct hot_range), compare_instructions);
+    fprintf(out, "\nHottest basic blocks:\n");
+    print_ranges(profile, out, ranges, n_ranges, total, "entries");
+
+    // loops run from the target of a backward jump up to the jump
+    n_ranges = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int op = profile->program[i].op;
+        long target = jump_target(profile, i);
+        if (!(is_branch(op) || op == OP_JAL) || target < 0 || target > i)
+            continue;
+        long iterations = is_branch(op) ? profile->taken[i] : profile->counts[i];
+        if (iterations == 0)
+            continue;
+        struct hot_range *loop = &ranges[n_ranges++];
+        loop->first = target;
+        loop->last = i;
+        loop->count = iterations;
+        sum_range(profile, loop);
+    }
+    qsort(ranges, n_ranges, sizeof(struct hot_range), compare_instructions);
+    fprintf(out, "\nHottest loops:\n");
+    print_ranges(profile, out, ranges, n_ranges, total, "iterations");
+
+    n_ranges = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (!is_branch(profile->program[i].op) || profile->counts[i] == 0)
+            continue;
+        struct hot_range *branch = &ranges[n_ranges++];
+        branch->first = i;
+        branch->count = profile->counts[i];
+    }
+    qsort(ranges, n_ranges, sizeof(struct hot_range), compare_count);
+    fprintf(out, "\nHottest branches:\n");
+    fprintf(out, "  %-10s  %10s  %10s  %10s  %7s\n", "pc", "executed", "taken", "not taken", "taken");
+    for (int i = 0; i < n_ranges && i < PROFILE_TOP; i++)
+    {
+        uint32_t index = ranges[i].first;
+        long taken = profile->taken[index];
+        fprintf(out, "  0x%08x  %10ld  %10ld  %10ld  %6.1f%%\n", profile->text_base + 4 * index, ranges[i].count,
+                taken, ranges[i].count - taken, 100.0 * taken / ranges[i].count);
+    }
+    free(ranges);
+}
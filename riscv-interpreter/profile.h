@@ -0,0 +1,53 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct inst;
+
+/**
+ * Type alias for the internal representation of the profiler.
+ * Defined in profile.c:
+ *
+ *     struct profile {
+ *         ...
+ *     }
+ *
+ * The profiler counts how often each instruction of a decoded program
+ * runs and which way each branch goes, and times every basic block with
+ * the host clock as execution enters it.
+ */
+typedef struct profile profile_t;
+
+/**
+ * Return a pointer to a new profiler for the decoded program, whose first
+ * instruction is at guest address text_base
+ */
+profile_t *profile_init(struct inst *program, int no_of_instructions, uint32_t text_base);
+
+/**
+ * Free a profiler
+ */
+void profile_free(profile_t *profile);
+
+/**
+ * Records that the instruction at index is about to execute. Call it for
+ * every instruction, in the order they execute.
+ */
+void profile_step(profile_t *profile, uint32_t index);
+
+/**
+ * Records whether the conditional branch at index was taken
+ */
+void profile_branch(profile_t *profile, uint32_t index, bool taken);
+
+/**
+ * Ends the run, charging the time since the last block was entered to it
+ */
+void profile_stop(profile_t *profile);
+
+/**
+ * Prints the totals per opcode class, then the hottest basic blocks,
+ * loops and branches, with how many guest instructions each executed and
+ * how many host ns each took per guest instruction
+ */
+void profile_print(profile_t *profile, FILE *out);
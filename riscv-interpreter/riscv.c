@@ -2,76 +2,46 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include "linkedlist.h"
-#include "hashtable.h"
+#include <stdint.h>
+#include <time.h>
+#include "memory.h"
 #include "riscv.h"
+#include "decode.h"
+#include "jit.h"
+#include "profile.h"
+#include "pipeline.h"
+#include "trace.h"
 
-/************** BEGIN HELPER FUNCTIONS ***************/
-const int R_TYPE = 0;
-const int I_TYPE = 1;
-const int MEM_TYPE = 2;
-const int U_TYPE = 3;
-const int B_TYPE = 4;
-const int UNKNOWN_TYPE = 5;
-
-/**
- * Return the type of instruction for the given operation
- * Available options are R_TYPE, I_TYPE, MEM_TYPE, U_TYPE, B_TYPE, UNKNOWN_TYPE
- */
-static int get_op_type(char *op)
-{
-    const char *r_type_op[] = {"add", "sub", "and", "slt", "sll", "sra"};
-    const char *i_type_op[] = {"addi", "andi"};
-    const char *mem_type_op[] = {"lw", "lb", "sw", "sb"};
-    const char *u_type_op[] = {"lui"};
-    const char *b_type_op[] = {"beq"};
-    for (int i = 0; i < (int)(sizeof(r_type_op) / sizeof(char *)); i++)
-    {
-        if (strcmp(r_type_op[i], op) == 0)
-        {
-            return R_TYPE;
-        }
-    }
-    for (int i = 0; i < (int)(sizeof(i_type_op) / sizeof(char *)); i++)
-    {
-        if (strcmp(i_type_op[i], op) == 0)
-        {
-            return I_TYPE;
-        }
-    }
-    for (int i = 0; i < (int)(sizeof(mem_type_op) / sizeof(char *)); i++)
-    {
-        if (strcmp(mem_type_op[i], op) == 0)
-        {
-            return MEM_TYPE;
-        }
-    }
-    for (int i = 0; i < (int)(sizeof(u_type_op) / sizeof(char *)); i++)
-    {
-        if (strcmp(u_type_op[i], op) == 0)
-        {
-            return U_TYPE;
-        }
-    }
-    for (int i = 0; i < (int)(sizeof(b_type_op) / sizeof(char *)); i++)
-    {
-        if (strcmp(b_type_op[i], op) == 0)
-        {
-            return B_TYPE;
-        }
-    }
-    return UNKNOWN_TYPE;
-}
-/*************** END HELPER FUNCTIONS ****************/
+// GCC and clang support labels as values, which the threaded engine needs
+#if defined(__GNUC__) && !defined(NO_THREADED_DISPATCH)
+#define THREADED_DISPATCH
+#define DEFAULT_ENGINE ENGINE_THREADED
+#else
+#define DEFAULT_ENGINE ENGINE_SWITCH
+#endif
 
 registers_t *registers;
 char **program;
+inst_t *decoded; // program, decoded by evaluate_program
 int no_of_instructions;
 
-#define BUFFER_SIZE 256
-char buf[BUFFER_SIZE];
 int pc;
-hashtable_t *memory;
+uint32_t text_base; // guest address of decoded[0]
+bool binary_f;      // loaded from a binary, traces are only made when needed
+bool traces_f;      // the traces of a binary program are made
+int engine = DEFAULT_ENGINE;
+int trace_level = TRACE_FULL; // which instructions are traced as they execute
+const char *trace_log;        // binary log the trace goes to, or NULL for stdout
+int linked_level = -1;        // trace level the threaded handlers are linked for
+jit_t *jit;           // created by the first run on ENGINE_JIT
+int jit_trace_level;  // trace level jit was created with
+memory_t *memory;
+bool profile_f;       // run on the profiling engine and print a report
+profile_t *profile;
+int predictor = -1;   // run the pipeline timing model with this predictor
+int predictor_bits;
+bool forwarding_f;
+pipeline_t *pipeline;
 
 void init(registers_t *starting_registers, char **input_program, int given_no_of_instructions)
 {
@@ -79,238 +49,676 @@ void init(registers_t *starting_registers, char **input_program, int given_no_of
     program = input_program;
     no_of_instructions = given_no_of_instructions;
 
+    decoded = NULL;
+    jit = NULL;
     pc = 0;
-    memory = ht_init(2000);
+    text_base = 0;
+    binary_f = false;
+    memory = mem_init();
+}
+
+void init_decoded(registers_t *starting_registers, inst_t *input_program, int given_no_of_instructions,
+                  uint32_t given_text_base, uint32_t entry, memory_t *given_memory)
+{
+    registers = starting_registers;
+    program = NULL;
+    decoded = input_program;
+    no_of_instructions = given_no_of_instructions;
+
+    jit = NULL;
+    pc = entry;
+    text_base = given_text_base;
+    binary_f = true;
+    traces_f = false;
+    memory = given_memory;
 }
 
 void end()
 {
     // Free everything from memory
     free(registers);
-    for (int i = 0; i < no_of_instructions; i++)
+    if (program)
     {
-        free(program[i]);
+        for (int i = 0; i < no_of_instructions; i++)
+        {
+            free(program[i]);
+        }
+        free(program);
+    }
+    if (decoded)
+    {
+        for (int i = 0; i < no_of_instructions; i++)
+        {
+            free(decoded[i].trace);
+        }
+        free(decoded);
     }
-    free(program);
-    ht_free(memory);
+    mem_free(memory);
+    jit_free(jit);
 }
 
 /**
- * Copy of the C standard library isspace function
+ * Division and remainder as RISC-V defines them: dividing by zero and
+ * overflowing do not trap but give fixed results.
  */
-int isspace(int c)
+static int divide(int a, int b)
 {
-    return c == '\t' || c == '\n' ||
-           c == '\v' || c == '\f' || c == '\r' || c == ' ';
+    if (b == 0)
+        return -1;
+    if (a == INT32_MIN && b == -1)
+        return a;
+    return a / b;
 }
 
+static int divide_unsigned(uint32_t a, uint32_t b)
+{
+    return b == 0 ? UINT32_MAX : a / b;
+}
+
+static int remainder_signed(int a, int b)
+{
+    if (b == 0)
+        return a;
+    if (a == INT32_MIN && b == -1)
+        return 0;
+    return a % b;
+}
+
+static int remainder_unsigned(uint32_t a, uint32_t b)
+{
+    return b == 0 ? a : a % b;
+}
+
+/*
+ * The effect of each operation, shared by the dispatch loops below.
+ * They expect r to point at the register file and inst at the instruction.
+ */
+#define RD r[inst->rd]
+#define RS1 r[inst->rs1]
+#define RS2 r[inst->rs2]
+#define U_RS1 ((uint32_t)RS1)
+#define U_RS2 ((uint32_t)RS2)
+#define ADDR (inst->imm + RS1)
+// only use 5 LSBs for shift amounts
+#define SHAMT_RS2 (RS2 & 0x0000001F)
+#define SHAMT_IMM (inst->imm & 0x0000001F)
+
+/*
+ * Operations that only update registers or memory
+ */
+#define SIMPLE_OPS(X)                                                        \
+    X(NOP) X(ADD) X(SUB) X(AND) X(OR) X(XOR) X(SLT) X(SLTU) X(SLL) X(SRL)  \
+    X(SRA) X(MUL) X(MULH) X(MULHSU) X(MULHU) X(DIV) X(DIVU) X(REM) X(REMU) \
+    X(ADDI) X(ANDI) X(ORI) X(XORI) X(SLTI) X(SLTIU) X(SLLI) X(SRLI)        \
+    X(SRAI) X(LW) X(LH) X(LHU) X(LB) X(LBU) X(SW) X(SH) X(SB) X(LUI)       \
+    X(AUIPC)
+#define EXEC_NOP
+#define EXEC_ADD RD = RS1 + RS2
+#define EXEC_SUB RD = RS1 - RS2
+#define EXEC_AND RD = RS1 & RS2
+#define EXEC_OR RD = RS1 | RS2
+#define EXEC_XOR RD = RS1 ^ RS2
+#define EXEC_SLT RD = (RS1 < RS2) ? 1 : 0
+#define EXEC_SLTU RD = (U_RS1 < U_RS2) ? 1 : 0
+#define EXEC_SLL RD = RS1 << SHAMT_RS2
+#define EXEC_SRL RD = U_RS1 >> SHAMT_RS2
+// >> is arithmetic shift by default since ints are signed
+#define EXEC_SRA RD = RS1 >> SHAMT_RS2
+#define EXEC_MUL RD = U_RS1 * U_RS2
+#define EXEC_MULH RD = ((int64_t)RS1 * RS2) >> 32
+#define EXEC_MULHSU RD = ((int64_t)RS1 * U_RS2) >> 32
+#define EXEC_MULHU RD = ((uint64_t)U_RS1 * U_RS2) >> 32
+#define EXEC_DIV RD = divide(RS1, RS2)
+#define EXEC_DIVU RD = divide_unsigned(RS1, RS2)
+#define EXEC_REM RD = remainder_signed(RS1, RS2)
+#define EXEC_REMU RD = remainder_unsigned(RS1, RS2)
+#define EXEC_ADDI RD = RS1 + inst->imm
+#define EXEC_ANDI RD = RS1 & inst->imm
+#define EXEC_ORI RD = RS1 | inst->imm
+#define EXEC_XORI RD = RS1 ^ inst->imm
+#define EXEC_SLTI RD = (RS1 < inst->imm) ? 1 : 0
+#define EXEC_SLTIU RD = (U_RS1 < (uint32_t)inst->imm) ? 1 : 0
+#define EXEC_SLLI RD = RS1 << SHAMT_IMM
+#define EXEC_SRLI RD = U_RS1 >> SHAMT_IMM
+#define EXEC_SRAI RD = RS1 >> SHAMT_IMM
+#define EXEC_LW RD = mem_read_word(memory, ADDR)
+#define EXEC_LH RD = (int16_t)mem_read_half(memory, ADDR)
+#define EXEC_LHU RD = mem_read_half(memory, ADDR)
+#define EXEC_LB RD = sign_extend(mem_read_byte(memory, ADDR), 8)
+#define EXEC_LBU RD = mem_read_byte(memory, ADDR)
+#define EXEC_SW mem_write_word(memory, ADDR, RD)
+#define EXEC_SH mem_write_half(memory, ADDR, RD)
+#define EXEC_SB mem_write_byte(memory, ADDR, RD)
+#define EXEC_LUI RD = inst->imm
+#define EXEC_AUIPC RD = pc + inst->imm
+
+/*
+ * Conditional branches, taken to pc + imm when the condition holds
+ */
+#define BRANCH_OPS(X) X(BEQ) X(BNE) X(BLT) X(BGE) X(BLTU) X(BGEU)
+#define COND_BEQ (RS1 == RS2)
+#define COND_BNE (RS1 != RS2)
+#define COND_BLT (RS1 < RS2)
+#define COND_BGE (RS1 >= RS2)
+#define COND_BLTU (U_RS1 < U_RS2)
+#define COND_BGEU (U_RS1 >= U_RS2)
+
+// jal and jalr jump to these and link pc + 4 into rd, unless rd is x0
+#define TARGET_JAL (pc + inst->imm)
+#define TARGET_JALR ((RS1 + inst->imm) & ~1)
+
+// ecall with the exit system call number in a7 ends the program by
+// jumping to HALT_PC, just below it. Other system calls do nothing.
+#define SYS_EXIT 93
+#define COND_EXIT (r[17] == SYS_EXIT)
+#define HALT_PC ((int)(text_base - 4))
+
 /**
- * Given a string, trim any leading or trailing space surrounding it
+ * Executes one decoded instruction.
+ * Returns whether it was a conditional branch that was taken.
  */
-char *trim_spaces(char *s)
+static bool execute(inst_t *inst)
 {
-    while (isspace(*s)) // trim leading space
-        s++;
+    int *r = registers->r;
+    int target;
 
-    char *end = s + strlen(s) - 1;
-    while (end > s && isspace(*end)) // trim trailing space
-        end--;
-    end[1] = '\0';
+    switch (inst->op)
+    {
+#define CASE(name)   \
+    case OP_##name:  \
+        EXEC_##name; \
+        break;
+        SIMPLE_OPS(CASE)
+#undef CASE
+
+#define CASE(name)                       \
+    case OP_##name:                      \
+        if (COND_##name)                 \
+        {                                \
+            /* assume that all offsets are valid */ \
+            pc += inst->imm - 4;         \
+            return true;                 \
+        }                                \
+        break;
+        BRANCH_OPS(CASE)
+#undef CASE
 
-    return s;
+    case OP_JAL:
+        target = TARGET_JAL;
+        if (inst->rd)
+            RD = pc + 4;
+        pc = target - 4;
+        break;
+    case OP_JALR:
+        target = TARGET_JALR;
+        if (inst->rd)
+            RD = pc + 4;
+        pc = target - 4;
+        break;
+    case OP_ECALL:
+        if (COND_EXIT)
+            pc = HALT_PC - 4;
+        break;
+    }
+    return false;
+}
+
+void step(char *instruction)
+{
+    inst_t inst;
+    decode_instruction(instruction, &inst);
+    if (inst.trace)
+    {
+        puts(inst.trace);
+    }
+    if (execute(&inst))
+    {
+        printf("branch\n");
+    }
+    free(inst.trace);
 }
 
 /**
- * Sign extend an x bit immediate value to 32 bits
+ * Returns the index in decoded of the instruction at pc
  */
-int sign_extend(int imm_v, int imm_num_bits)
+static inline uint32_t pc_index()
 {
-    // only want the x LSBs: << by 32-x to remove extra bits and
-    // >> by 32-x to sign extend to 32 bits (since >> is arithmetic shift on ints)
-    return (imm_v << (32 - imm_num_bits)) >> (32 - imm_num_bits);
+    return ((uint32_t)pc - text_base) / 4;
 }
 
 /**
- * Given a hex or decimal string representing an x bit immediate value,
- * convert it to an int and sign extend it to 32 bits.
+ * Returns whether pc points inside the program
  */
-int process_imm(char *imm, int imm_num_bits)
+static bool pc_in_program()
 {
-    int imm_v = strtol(imm, NULL, 0);
-    return sign_extend(imm_v, imm_num_bits);
+    return pc_index() < (uint32_t)no_of_instructions;
 }
 
-void step(char *instruction)
+/**
+ * Executes the instruction at index in the program, tracing it if the
+ * trace level covers it.
+ * Returns whether it was a conditional branch that was taken.
+ */
+static bool execute_traced(uint32_t index)
 {
-    // Extracts and returns the substring before the first space character,
-    // by replacing the space character with a null-terminator.
-    // `instruction` is MODIFIED IN PLACE to point to the next character
-    // after the space. See `man strsep` for how this library function works.
-    char *op = strsep(&instruction, " ");
-    int op_type = get_op_type(op); // type of instruction
-
-    if (op_type == R_TYPE)
+    inst_t *inst = &decoded[index];
+    if (!is_traced(inst->op, trace_level))
     {
-        char *rd = trim_spaces(strsep(&instruction, ","));
-        char *r1 = trim_spaces(strsep(&instruction, ","));
-        char *r2 = trim_spaces(instruction);
-        printf("%s/%s/%s/%s\n", op, rd, r1, r2);
-
-        int rd_r = atoi(rd + 1); // offset by 1 to remove x
-        int r1_r = atoi(r1 + 1);
-        int r2_r = atoi(r2 + 1);
+        return execute(inst);
+    }
+    trace_inst(index);
+    bool taken = execute(inst);
+    if (taken)
+    {
+        trace_taken();
+    }
+    return taken;
+}
 
-        // disallow writing to x0
-        if (rd_r == 0)
+/**
+ * The portable engine: a switch over the opcode for every instruction.
+ * With tracing off, it runs a loop that has no tracing in it at all.
+ * Returns the number of instructions executed.
+ */
+static long run_switch()
+{
+    long n_executed = 0;
+    if (trace_level == TRACE_OFF)
+    {
+        while (pc_in_program())
         {
-            return;
+            execute(&decoded[pc_index()]);
+            pc += 4;
+            n_executed++;
         }
+        return n_executed;
+    }
 
-        if (strcmp("add", op) == 0)
-        {
-            registers->r[rd_r] = registers->r[r1_r] + registers->r[r2_r];
-        }
-        else if (strcmp("sub", op) == 0)
+    while (pc_in_program())
+    {
+        execute_traced(pc_index());
+        pc += 4;
+        n_executed++;
+    }
+    return n_executed;
+}
+
+#ifdef THREADED_DISPATCH
+/**
+ * The threaded engine: every decoded instruction carries the address of
+ * its handler, and each handler ends by jumping straight to the handler
+ * of the next instruction, so there is no central dispatch branch.
+ * Instructions the trace level covers are linked to a handler that traces
+ * them first, so untraced instructions pay nothing for tracing.
+ * Called with link_f set, it only fills in the handler addresses.
+ * Returns the number of instructions executed.
+ */
+static long run_threaded(bool link_f)
+{
+#define HANDLER(name) [OP_##name] = &&do_##name,
+    static const void *handlers[NO_OF_OPCODES] = {
+        SIMPLE_OPS(HANDLER) BRANCH_OPS(HANDLER) HANDLER(JAL) HANDLER(JALR) HANDLER(ECALL)};
+#undef HANDLER
+#define HANDLER(name) [OP_##name] = &&trace_##name,
+    static const void *traced_handlers[NO_OF_OPCODES] = {
+        SIMPLE_OPS(HANDLER) BRANCH_OPS(HANDLER) HANDLER(JAL) HANDLER(JALR) HANDLER(ECALL)};
+#undef HANDLER
+
+    if (link_f)
+    {
+        for (int i = 0; i < no_of_instructions; i++)
         {
-            registers->r[rd_r] = registers->r[r1_r] - registers->r[r2_r];
+            int op = decoded[i].op;
+            decoded[i].handler = is_traced(op, trace_level) ? traced_handlers[op] : handlers[op];
         }
-        else if (strcmp("and", op) == 0)
+        // falling off the end of the program lands on the sentinel
+        decoded[no_of_instructions].handler = &&halt;
+        linked_level = trace_level;
+        return 0;
+    }
+
+    int *r = registers->r;
+    long n_executed = 0;
+    int target;
+    if (!pc_in_program())
+    {
+        return 0;
+    }
+    inst_t *inst = &decoded[pc_index()];
+
+#define DISPATCH() goto *inst->handler
+#define NEXT()        \
+    do                \
+    {                 \
+        n_executed++; \
+        inst++;       \
+        pc += 4;      \
+        DISPATCH();   \
+    } while (0)
+#define JUMP()                      \
+    do                              \
+    {                               \
+        n_executed++;               \
+        pc = target;                \
+        if (!pc_in_program())       \
+            goto halt;              \
+        inst = &decoded[pc_index()];    \
+        DISPATCH();                 \
+    } while (0)
+
+    DISPATCH();
+
+#define SIMPLE(name) \
+    do_##name:       \
+    EXEC_##name;     \
+    NEXT();
+    SIMPLE_OPS(SIMPLE)
+#undef SIMPLE
+
+#define BRANCH(name)            \
+    do_##name:                  \
+    if (!(COND_##name))         \
+        NEXT();                 \
+    target = pc + inst->imm;    \
+    JUMP();
+    BRANCH_OPS(BRANCH)
+#undef BRANCH
+
+do_JAL:
+    target = TARGET_JAL;
+    if (inst->rd)
+        RD = pc + 4;
+    JUMP();
+do_JALR:
+    target = TARGET_JALR;
+    if (inst->rd)
+        RD = pc + 4;
+    JUMP();
+do_ECALL:
+    if (!COND_EXIT)
+        NEXT();
+    target = HALT_PC;
+    JUMP();
+
+halt:
+    return n_executed;
+
+    // traced instructions go through these on the way to their handler
+#define TRACED(name)              \
+    trace_##name:                 \
+    trace_inst(inst - decoded);   \
+    goto do_##name;
+    SIMPLE_OPS(TRACED)
+    TRACED(JAL)
+    TRACED(JALR)
+    TRACED(ECALL)
+#undef TRACED
+
+#define TRACED_BRANCH(name)       \
+    trace_##name:                 \
+    trace_inst(inst - decoded);   \
+    if (COND_##name)              \
+        trace_taken();            \
+    goto do_##name;
+    BRANCH_OPS(TRACED_BRANCH)
+#undef TRACED_BRANCH
+
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+}
+#endif
+
+/**
+ * The JIT engine: runs translated basic blocks, and interprets whatever
+ * the JIT cannot translate. Falls back to the interpreter entirely if
+ * the host has no JIT.
+ * Returns the number of instructions executed.
+ */
+static long run_jit()
+{
+    if (jit == NULL || jit_trace_level != trace_level)
+    {
+        jit_free(jit);
+        jit = jit_init(decoded, no_of_instructions, text_base, trace_level);
+        jit_trace_level = trace_level;
+    }
+    if (jit == NULL)
+    {
+        return run_switch();
+    }
+
+    long n_executed = 0;
+    while (pc_in_program())
+    {
+        if (!jit_run(jit, &pc, registers->r, memory, &n_executed))
         {
-            registers->r[rd_r] = registers->r[r1_r] & registers->r[r2_r];
+            execute_traced(pc_index());
+            pc += 4;
+            n_executed++;
         }
-        else if (strcmp("slt", op) == 0)
+    }
+    return n_executed;
+}
+
+/**
+ * The instrumented engine: the switch engine, telling the profiler and
+ * the pipeline timing model, whichever are enabled, about every
+ * instruction.
+ * Returns the number of instructions executed.
+ */
+static long run_instrumented()
+{
+    long n_executed = 0;
+    while (pc_in_program())
+    {
+        uint32_t index = pc_index();
+        inst_t *inst = &decoded[index];
+        uint32_t inst_pc = pc;
+        if (profile)
         {
-            registers->r[rd_r] = (registers->r[r1_r] < registers->r[r2_r]) ? 1 : 0;
+            profile_step(profile, index);
         }
-        else if (strcmp("sll", op) == 0)
+        bool taken = trace_level == TRACE_OFF ? execute(inst) : execute_traced(index);
+        if (profile && is_branch(inst->op))
         {
-            // only use 5 LSBs for shift amount
-            registers->r[rd_r] = registers->r[r1_r] << (registers->r[r2_r] & 0x0000001F);
+            profile_branch(profile, index, taken);
         }
-        else if (strcmp("sra", op) == 0)
+        if (pipeline)
         {
-            // >> is arithmetic shift by default since ints are signed
-            registers->r[rd_r] = registers->r[r1_r] >> (registers->r[r2_r] & 0x0000001F);
+            pipeline_step(pipeline, inst, inst_pc, taken);
         }
+        pc += 4;
+        n_executed++;
     }
-    else if (op_type == I_TYPE)
+    if (profile)
     {
-        char *rd = trim_spaces(strsep(&instruction, ","));
-        char *r1 = trim_spaces(strsep(&instruction, ","));
-        char *imm = trim_spaces(instruction);
-        printf("%s/%s/%s/%s\n", op, rd, r1, imm);
+        profile_stop(profile);
+    }
+    return n_executed;
+}
 
-        int rd_r = atoi(rd + 1);
-        int r1_r = atoi(r1 + 1);
-        int imm_v = process_imm(imm, 12);
+/**
+ * Decodes the whole program up front, so that the execute loops never
+ * touch the instruction text. Programs loaded from a binary arrive
+ * already decoded.
+ */
+static void decode_program()
+{
+    if (decoded)
+    {
+#ifdef THREADED_DISPATCH
+        run_threaded(true);
+#endif
+        return;
+    }
 
-        if (rd_r == 0)
-        {
-            return;
-        }
+    decoded = decode_lines(program, no_of_instructions);
+#ifdef THREADED_DISPATCH
+    run_threaded(true);
+#endif
+}
 
-        if (strcmp("addi", op) == 0)
+/**
+ * Makes the traces of a program loaded from a binary, from the machine
+ * code still in guest memory. Instructions that already have a trace,
+ * such as those of a cached program, keep it.
+ */
+static void disassemble_program()
+{
+    for (int i = 0; i < no_of_instructions; i++)
+    {
+        if (decoded[i].trace == NULL)
         {
-            registers->r[rd_r] = registers->r[r1_r] + imm_v;
+            decoded[i].trace = disassemble(mem_read_word(memory, text_base + 4 * i));
         }
-        else if (strcmp("andi", op) == 0)
+    }
+    traces_f = true;
+}
+
+/**
+ * Runs the decoded program from pc with the selected engine
+ */
+static long run_program(int use_engine)
+{
+    if (use_engine == ENGINE_JIT)
+    {
+        return run_jit();
+    }
+#ifdef THREADED_DISPATCH
+    if (use_engine == ENGINE_THREADED)
+    {
+        if (linked_level != trace_level)
         {
-            registers->r[rd_r] = registers->r[r1_r] & imm_v;
+            run_threaded(true);
         }
+        return run_threaded(false);
     }
-    else if (op_type == MEM_TYPE)
-    {
-        // target is rd for loads and r2 for stores
-        char *target = trim_spaces(strsep(&instruction, ","));
-        char *imm = trim_spaces(strsep(&instruction, "("));
-        char *r1 = trim_spaces(strsep(&instruction, ")"));
-        printf("%s/%s/%s/%s\n", op, target, imm, r1);
+#endif
+    return run_switch();
+}
 
-        int target_r = atoi(target + 1);
-        int imm_v = process_imm(imm, 12);
-        int r1_r = atoi(r1 + 1);
+void set_engine(int new_engine)
+{
+    engine = new_engine;
+}
 
-        int addr = imm_v + registers->r[r1_r];
+void set_trace(int level, const char *log_path)
+{
+    trace_level = level;
+    trace_log = log_path;
+}
 
-        // disallow writing to x0 for loads
-        if (op[0] == 'l' && target_r == 0)
-        {
-            return;
-        }
+void set_profiling(int new_profile_f)
+{
+    profile_f = new_profile_f;
+}
 
-        if (strcmp("lw", op) == 0)
-        {
-            // shift each byte to correct position and assemble int
-            int byte1 = ht_get(memory, addr);
-            int byte2 = ht_get(memory, addr + 1) << 8;
-            int byte3 = ht_get(memory, addr + 2) << 16;
-            int byte4 = ht_get(memory, addr + 3) << 24;
-            registers->r[target_r] = byte1 + byte2 + byte3 + byte4;
-        }
-        else if (strcmp("lb", op) == 0)
-        {
-            registers->r[target_r] = sign_extend(ht_get(memory, addr), 8);
-        }
-        else if (strcmp("sw", op) == 0)
-        {
-            // shift each byte to LSB position and mask away the other bytes
-            ht_add(memory, addr, registers->r[target_r] & 0x000000FF);
-            ht_add(memory, addr + 1, (registers->r[target_r] >> 8) & 0x000000FF);
-            ht_add(memory, addr + 2, (registers->r[target_r] >> 16) & 0x000000FF);
-            ht_add(memory, addr + 3, (registers->r[target_r] >> 24) & 0x000000FF);
-        }
-        else if (strcmp("sb", op) == 0)
-        {
-            ht_add(memory, addr, registers->r[target_r] & 0x000000FF);
-        }
+void set_pipeline(int new_predictor, int table_bits, int new_forwarding_f)
+{
+    predictor = new_predictor;
+    predictor_bits = table_bits;
+    forwarding_f = new_forwarding_f;
+}
+
+void evaluate_program()
+{
+    decode_program();
+    if (profile_f)
+    {
+        // the report replaces the trace, whose output would dominate the timings
+        profile = profile_init(decoded, no_of_instructions, text_base);
+        trace_level = TRACE_OFF;
     }
-    else if (op_type == U_TYPE)
+    if (predictor >= 0)
     {
-        char *rd = trim_spaces(strsep(&instruction, ","));
-        char *imm = trim_spaces(instruction);
-        printf("%s/%s/%s\n", op, rd, imm);
-
-        int rd_r = atoi(rd + 1);
-        int imm_v = process_imm(imm, 20);
+        pipeline = pipeline_init(predictor, predictor_bits, forwarding_f);
+    }
 
-        if (rd_r == 0)
+    if (trace_level != TRACE_OFF)
+    {
+        if (binary_f && !traces_f)
         {
-            return;
+            disassemble_program();
         }
-
-        if (strcmp("lui", op) == 0)
+        if (trace_start(decoded, no_of_instructions, trace_log) != 0)
         {
-            registers->r[rd_r] = imm_v << 12;
+            return;
         }
     }
-    else if (op_type == B_TYPE)
+    if (profile || pipeline)
     {
-        char *r1 = trim_spaces(strsep(&instruction, ","));
-        char *r2 = trim_spaces(strsep(&instruction, ","));
-        char *imm = trim_spaces(instruction);
-        printf("%s/%s/%s/%s\n", op, r1, r2, imm);
-
-        int r1_r = atoi(r1 + 1);
-        int r2_r = atoi(r2 + 1);
-        int imm_v = process_imm(imm, 13);
+        run_instrumented();
+    }
+    else
+    {
+        run_program(engine);
+    }
+    if (trace_level != TRACE_OFF)
+    {
+        trace_stop();
+    }
 
-        if (strcmp("beq", op) == 0 && registers->r[r1_r] == registers->r[r2_r])
-        {
-            // assume that all offsets are valid
-            pc += imm_v - 4;
-            printf("branch\n");
-        }
+    if (profile)
+    {
+        profile_print(profile, stdout);
+        profile_free(profile);
+        profile = NULL;
+    }
+    if (pipeline)
+    {
+        pipeline_print(pipeline, stdout);
+        pipeline_free(pipeline);
+        pipeline = NULL;
     }
 }
 
-void evaluate_program()
+void benchmark(int iterations)
 {
-    // Logic for evaluating the program
-    while (pc / 4 < no_of_instructions)
+    const char *names[] = {[ENGINE_SWITCH] = "switch", [ENGINE_THREADED] = "threaded", [ENGINE_JIT] = "jit"};
+    registers_t start = *registers;
+    int start_pc = pc;
+    memory_t *start_memory = mem_clone(memory);
+
+    decode_program();
+    int start_level = trace_level;
+    trace_level = TRACE_OFF;
+    for (int e = ENGINE_SWITCH; e <= ENGINE_JIT; e++)
     {
-        // copy instructions so strsep does not modify original program
-        strncpy(buf, program[pc / 4], BUFFER_SIZE);
-        step(buf);
-        pc += 4;
+#ifndef THREADED_DISPATCH
+        if (e == ENGINE_THREADED)
+        {
+            printf("%-8s  not available in this build\n", names[e]);
+            continue;
+        }
+#endif
+#ifndef __x86_64__
+        if (e == ENGINE_JIT)
+        {
+            printf("%-8s  not available on this host\n", names[e]);
+            continue;
+        }
+#endif
+        long n_executed = 0;
+        double ns = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            // every iteration starts from the same registers and memory
+            *registers = start;
+            pc = start_pc;
+            mem_free(memory);
+            memory = mem_clone(start_memory);
+
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            n_executed += run_program(e);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+        }
+
+        printf("%-8s  %ld instructions in %.3f ms, %.2f ns/instruction\n",
+               names[e], n_executed, ns / 1e6, n_executed ? ns / n_executed : 0.0);
     }
+    trace_level = start_level;
+    mem_free(start_memory);
 }
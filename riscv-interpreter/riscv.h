@@ -7,6 +7,19 @@ struct registers
 };
 typedef struct registers registers_t;
 
+/**
+ * The execution engines. ENGINE_THREADED dispatches with computed gotos
+ * and is the default where the compiler supports it; ENGINE_SWITCH is the
+ * portable loop over a switch statement. ENGINE_JIT translates basic blocks
+ * to x86-64 code and interprets anything it cannot translate.
+ */
+enum engine
+{
+    ENGINE_SWITCH,
+    ENGINE_THREADED,
+    ENGINE_JIT
+};
+
 /**
  * Initializes the internal state with the given set of register values,
  * pointer to program, and number of instructions.
@@ -14,6 +27,19 @@ typedef struct registers registers_t;
  */
 void init(registers_t *starting_registers, char **input_program, int given_no_of_instructions);
 
+struct inst;
+struct memory;
+
+/**
+ * Initializes the internal state for a program that is already decoded,
+ * such as one loaded from a binary, instead of init(). The first
+ * instruction is at guest address text_base, execution starts at entry,
+ * and memory holds the program's data. Takes ownership of program, which
+ * must have one spare zeroed entry at the end, and of memory.
+ */
+void init_decoded(registers_t *starting_registers, struct inst *program, int given_no_of_instructions,
+                  unsigned int text_base, unsigned int entry, struct memory *memory);
+
 /**
  * Free every memory previously allocated.
  */
@@ -30,4 +56,42 @@ void step(char *instruction);
  * This method is called ONCE after the interpreter reads in the
  * whole program.
  */
-void evaluate_program();
\ No newline at end of file
+void evaluate_program();
+
+/**
+ * Selects the engine evaluate_program runs with. Falls back to
+ * ENGINE_SWITCH if the engine is not available in this build or host.
+ */
+void set_engine(int engine);
+
+/**
+ * Selects which instructions evaluate_program traces, as an enum
+ * trace_level, and where to: stdout as text if log_path is NULL, a binary
+ * log at log_path otherwise. Tracing everything to stdout is the default.
+ * With TRACE_OFF the engines run code without any tracing in it.
+ */
+void set_trace(int level, const char *log_path);
+
+/**
+ * With profile_f set, evaluate_program runs the program on the switch
+ * engine while counting how often every instruction executes and timing
+ * every basic block, then prints the hottest blocks, loops and branches
+ * instead of the trace.
+ */
+void set_profiling(int profile_f);
+
+/**
+ * With a predictor (an enum predictor) other than -1, evaluate_program
+ * runs the program on the switch engine through a timing model of a
+ * 5-stage in-order pipeline, with or without forwarding, that predicts
+ * branches with the predictor and a table of 2^table_bits counters. The
+ * cycles, CPI, stalls and mispredict rate are printed after the trace.
+ */
+void set_pipeline(int predictor, int table_bits, int forwarding_f);
+
+/**
+ * Runs the program the given number of times on every engine, without
+ * tracing, and prints how long each took.
+ * This method is called instead of evaluate_program().
+ */
+void benchmark(int iterations);
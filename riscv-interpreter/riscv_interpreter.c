@@ -3,11 +3,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include "riscv.h"
+#include "memory.h"
+#include "loader.h"
+#include "decode.h"
+#include "assembler.h"
+#include "trace.h"
+#include "pipeline.h"
 
 const char *COMMENT_START = "## start";
 const char *COMMENT_CYCLES = "## cycles";
 const int BUFFER_SIZE = 256;
 const int DEFAULT_NO_OF_INSTS = 50;
+const int DEFAULT_PREDICTOR_BITS = 10;
+const int STACK_TOP = 0x7ffffff0; // sp for programs loaded from a binary
 int DEBUG = 0;
 
 /**
@@ -70,34 +78,234 @@ void handle_start(char *s, registers_t *registers)
     }
 }
 
-char **handle_init(int no_of_instructions, registers_t *registers)
+/**
+ * Appends a copy of line to the growable array of source lines
+ */
+void add_source_line(char ***source, int *n_source, int *max_source, char *line)
+{
+    if (*n_source == *max_source)
+    {
+        *max_source = *max_source ? 2 * *max_source : 64;
+        *source = (char **)realloc(*source, *max_source * sizeof(char *));
+    }
+    (*source)[(*n_source)++] = strdup(line);
+}
+
+/**
+ * Assembles the source into `no_of_instructions` instruction slots and calls
+ * init() with the result. With a cache file, a program assembled and
+ * decoded by an earlier run from the same source is used instead when
+ * there is one, and the decoded program is saved to it otherwise.
+ * Returns 0 on success.
+ */
+int handle_init(char **source, int n_source, int no_of_instructions, registers_t *registers, char *cache)
 {
+    uint64_t key = hash_source(source, n_source, no_of_instructions);
+    if (cache)
+    {
+        inst_t *decoded = load_program_cache(cache, key, no_of_instructions);
+        if (decoded)
+        {
+            init_decoded(registers, decoded, no_of_instructions, 0, 0, mem_init());
+            return 0;
+        }
+    }
+
     // Allocate memory for `no_of_instructions` instructions
     char **program = (char **)calloc(no_of_instructions, sizeof(char *));
     for (int i = 0; i < no_of_instructions; i++)
     {
-        program[i] = (char *)calloc(BUFFER_SIZE, sizeof(char));
+        program[i] = (char *)calloc(LINE_SIZE, sizeof(char));
         if (program[i] == NULL)
             fprintf(stderr, "Cannot allocate space for program\n");
     }
+    int n = assemble(source, n_source, program, no_of_instructions);
+    if (n < 0 || n > no_of_instructions)
+    {
+        if (n > no_of_instructions)
+            fprintf(stderr, "Number of cycles beyond expectation.\n");
+        for (int i = 0; i < no_of_instructions; i++)
+        {
+            free(program[i]);
+        }
+        free(program);
+        return 1;
+    }
+
+    if (cache)
+    {
+        inst_t *decoded = decode_lines(program, no_of_instructions);
+        store_program_cache(cache, key, decoded, no_of_instructions);
+        for (int i = 0; i < no_of_instructions; i++)
+        {
+            free(program[i]);
+        }
+        free(program);
+        init_decoded(registers, decoded, no_of_instructions, 0, 0, mem_init());
+        return 0;
+    }
     // Call init() code with the allocated registers, program pointer, and program size
     init(registers, program, no_of_instructions);
-    return program;
+    return 0;
+}
+
+/**
+ * Returns the trace level with the given name, or -1 if there is none
+ */
+int parse_trace_level(char *name)
+{
+    const char *names[] = {[TRACE_OFF] = "off", [TRACE_BRANCHES] = "branches", [TRACE_FULL] = "full"};
+    for (int level = TRACE_OFF; level <= TRACE_FULL; level++)
+    {
+        if (strcmp(name, names[level]) == 0)
+        {
+            return level;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the branch predictor with the given name, or -1 if there is none
+ */
+int parse_predictor(char *name)
+{
+    const char *names[] = {[PREDICT_NOT_TAKEN] = "not-taken", [PREDICT_BIMODAL] = "bimodal",
+                           [PREDICT_GSHARE] = "gshare"};
+    for (int predictor = PREDICT_NOT_TAKEN; predictor <= PREDICT_GSHARE; predictor++)
+    {
+        if (strcmp(name, names[predictor]) == 0)
+        {
+            return predictor;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Prints the command line options to stderr
+ */
+void usage(char *name)
+{
+    fprintf(stderr, "usage: %s [-switch | -jit] [-bench <iterations> | -profile] [-trace <level>] [-trace-log <file>]\n"
+                    "       [-pipeline <predictor> [-predictor-bits <bits>] [-no-forwarding]]\n"
+                    "       [-load <binary> | [-cache <file>] < program]\n",
+            name);
+    fprintf(stderr, "  -switch             run on the portable switch engine\n");
+    fprintf(stderr, "  -jit                translate basic blocks to x86-64 code\n");
+    fprintf(stderr, "  -bench <iterations> time every engine over the program instead of tracing it\n");
+    fprintf(stderr, "  -profile            print the hottest blocks, loops and branches instead of\n");
+    fprintf(stderr, "                      the trace\n");
+    fprintf(stderr, "  -trace <level>      trace off, branches (and jumps) or full, the default\n");
+    fprintf(stderr, "  -trace-log <file>   write the trace to a binary log for trace_dump instead of\n");
+    fprintf(stderr, "                      to stdout\n");
+    fprintf(stderr, "  -pipeline <predictor>\n");
+    fprintf(stderr, "                      estimate the cycles on a 5-stage in-order pipeline that\n");
+    fprintf(stderr, "                      predicts branches not-taken, or with a bimodal or gshare\n");
+    fprintf(stderr, "                      predictor\n");
+    fprintf(stderr, "  -predictor-bits <bits>\n");
+    fprintf(stderr, "                      size the predictor at 2^bits counters, default %d\n",
+            DEFAULT_PREDICTOR_BITS);
+    fprintf(stderr, "  -no-forwarding      model the pipeline without forwarding\n");
+    fprintf(stderr, "  -load <binary>      run a static ELF32 executable or raw RV32 binary instead\n");
+    fprintf(stderr, "                      of reading assembly from stdin\n");
+    fprintf(stderr, "  -cache <file>       reuse the assembled and decoded program saved in file\n");
+    fprintf(stderr, "                      while the source is unchanged\n");
 }
 
 int main(int argc, char *argv[])
 {
+    int bench_iterations = 0;
+    char *binary = NULL;
+    char *cache = NULL;
+    int level = TRACE_FULL;
+    char *trace_log = NULL;
+    int predictor = -1;
+    int predictor_bits = DEFAULT_PREDICTOR_BITS;
+    int forwarding_f = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-switch") == 0)
+        {
+            set_engine(ENGINE_SWITCH);
+        }
+        else if (strcmp(argv[i], "-jit") == 0)
+        {
+            set_engine(ENGINE_JIT);
+        }
+        else if (strcmp(argv[i], "-bench") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            bench_iterations = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-profile") == 0)
+        {
+            set_profiling(1);
+        }
+        else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc && parse_trace_level(argv[i + 1]) >= 0)
+        {
+            level = parse_trace_level(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-trace-log") == 0 && i + 1 < argc)
+        {
+            trace_log = argv[++i];
+        }
+        else if (strcmp(argv[i], "-pipeline") == 0 && i + 1 < argc && parse_predictor(argv[i + 1]) >= 0)
+        {
+            predictor = parse_predictor(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-predictor-bits") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0 &&
+                 atoi(argv[i + 1]) <= 24)
+        {
+            predictor_bits = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-no-forwarding") == 0)
+        {
+            forwarding_f = 0;
+        }
+        else if (strcmp(argv[i], "-load") == 0 && i + 1 < argc)
+        {
+            binary = argv[++i];
+        }
+        else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc)
+        {
+            cache = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    set_trace(level, trace_log);
+    set_pipeline(predictor, predictor_bits, forwarding_f);
+
     // Allocate memory for 32 registers and return a pointer to the memory
     registers_t *registers = (registers_t *)calloc(1, sizeof(registers_t));
-    char **program = NULL;
+    // Lines of assembly as read, before labels and pseudo-instructions are assembled
+    char **source = NULL;
+    int n_source = 0;
+    int max_source = 0;
     // Set number of instructions
     int no_of_instructions = -1;
     // Use a temporary buffer to read a string into
     char buffer[BUFFER_SIZE];
-    // Keep track of the current instruction number
-    int inst_no = -1;
+    if (binary)
+    {
+        memory_t *memory = mem_init();
+        loaded_program_t loaded;
+        if (load_binary(binary, memory, &loaded) != 0)
+        {
+            mem_free(memory);
+            free(registers);
+            return 1;
+        }
+        registers->r[2] = STACK_TOP;
+        init_decoded(registers, loaded.program, loaded.no_of_instructions,
+                     loaded.text_base, loaded.entry, memory);
+    }
     // Read from stdin until an EOF (sent using Ctrl+D)
-    while (fgets(buffer, BUFFER_SIZE, stdin) != NULL)
+    while (!binary && fgets(buffer, BUFFER_SIZE, stdin) != NULL)
     {
         // Convert the newline at the end of a line to a null-terminator
         buffer[strcspn(buffer, "\r\n")] = 0;
@@ -107,7 +315,6 @@ int main(int argc, char *argv[])
             cycles = ltrim_spaces(cycles);
             strsep(&cycles, "=");
             no_of_instructions = (int)strtol(cycles, NULL, 0);
-            program = handle_init(no_of_instructions, registers);
             continue;
         }
         // Handles the comment which initializes a register to a value
@@ -127,33 +334,39 @@ int main(int argc, char *argv[])
         strlower(buffer);
 
         char *instruction = ltrim_spaces(buffer);
-        if (strlen(instruction) == 0)
+        if (strlen(instruction) > 0)
         {
-            continue;
+            add_source_line(&source, &n_source, &max_source, instruction);
         }
-        else
+    }
+    if (!binary)
+    {
+        if (no_of_instructions == -1)
         {
-            if (no_of_instructions == -1)
-            {
-                no_of_instructions = DEFAULT_NO_OF_INSTS;
-                // printf("Using default number of cycles: %d\n", DEFAULT_NO_OF_INSTS);
-                program = handle_init(no_of_instructions, registers);
-            }
-            inst_no++;
-            if (inst_no < no_of_instructions)
-            {
-                strcpy(program[inst_no], instruction);
-            }
-            else
-            {
-                fprintf(stderr, "Number of cycles beyond expectation.\n");
-                end();
-                return 1;
-            }
+            no_of_instructions = DEFAULT_NO_OF_INSTS;
+            // printf("Using default number of cycles: %d\n", DEFAULT_NO_OF_INSTS);
+        }
+        int error = handle_init(source, n_source, no_of_instructions, registers, cache);
+        for (int i = 0; i < n_source; i++)
+        {
+            free(source[i]);
+        }
+        free(source);
+        if (error)
+        {
+            free(registers);
+            return 1;
         }
     }
     // After entire program is read from stdin, call evaluate_program() code
-    evaluate_program();
+    if (bench_iterations > 0)
+    {
+        benchmark(bench_iterations);
+    }
+    else
+    {
+        evaluate_program();
+    }
 
     // Print the register values
     print_registers(registers);
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode.h"
+#include "trace.h"
+
+#define TRACE_BUFFER_RECORDS 8192 // records written to the log at a time
+
+static inst_t *program;
+static FILE *log_file; // NULL when tracing to stdout as text
+static uint32_t buffer[TRACE_BUFFER_RECORDS];
+static int n_buffered;
+
+int is_traced(int op, int level)
+{
+    return level == TRACE_FULL || (level == TRACE_BRANCHES && (is_branch(op) || op == OP_JAL || op == OP_JALR));
+}
+
+int trace_start(inst_t *traced_program, int no_of_instructions, const char *log_path)
+{
+    program = traced_program;
+    n_buffered = 0;
+    if (log_path == NULL)
+    {
+        return 0;
+    }
+
+    log_file = fopen(log_path, "wb");
+    if (log_file == NULL)
+    {
+        fprintf(stderr, "Cannot open trace log %s\n", log_path);
+        return -1;
+    }
+
+    // the header lets trace_dump print records without the program
+    uint32_t n = no_of_instructions;
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), log_file);
+    fwrite(&n, sizeof(n), 1, log_file);
+    for (int i = 0; i < no_of_instructions; i++)
+    {
+        uint16_t len = program[i].trace ? strlen(program[i].trace) : 0;
+        fwrite(&len, sizeof(len), 1, log_file);
+        fwrite(program[i].trace, 1, len, log_file);
+    }
+    return 0;
+}
+
+/**
+ * Writes out the buffered records but the last, which a taken branch may
+ * still have to mark
+ */
+static void flush_records()
+{
+    fwrite(buffer, sizeof(uint32_t), n_buffered - 1, log_file);
+    buffer[0] = buffer[n_buffered - 1];
+    n_buffered = 1;
+}
+
+void trace_inst(uint32_t index)
+{
+    if (log_file == NULL)
+    {
+        if (program[index].trace)
+        {
+            puts(program[index].trace);
+        }
+        return;
+    }
+
+    if (n_buffered == TRACE_BUFFER_RECORDS)
+    {
+        flush_records();
+    }
+    buffer[n_buffered++] = index;
+}
+
+void trace_taken()
+{
+    if (log_file == NULL)
+    {
+        printf("branch\n");
+        return;
+    }
+    buffer[n_buffered - 1] |= TRACE_TAKEN;
+}
+
+void trace_stop()
+{
+    if (log_file == NULL)
+    {
+        return;
+    }
+    fwrite(buffer, sizeof(uint32_t), n_buffered, log_file);
+    n_buffered = 0;
+    fclose(log_file);
+    log_file = NULL;
+}
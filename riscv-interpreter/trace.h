@@ -0,0 +1,49 @@
+#include <stdint.h>
+
+struct inst;
+
+/**
+ * How much of the execution is traced. TRACE_BRANCHES only traces
+ * conditional branches, jal and jalr, still followed by "branch" when a
+ * conditional branch is taken.
+ */
+enum trace_level
+{
+    TRACE_OFF,
+    TRACE_BRANCHES,
+    TRACE_FULL
+};
+
+/**
+ * Returns whether instructions with the opcode are traced at the level
+ */
+int is_traced(int op, int level);
+
+/**
+ * Starts tracing the decoded program. Without a log_path, every traced
+ * instruction prints its trace line to stdout. Otherwise the trace is a
+ * binary log written to log_path through a buffer: a header holding every
+ * instruction's trace line, then one 32 bit record per instruction
+ * executed, its index in the program with TRACE_TAKEN set if it was a
+ * taken branch. trace_dump prints a log as the text trace.
+ * Returns 0 on success, or -1 after printing why the log cannot be opened.
+ */
+int trace_start(struct inst *program, int no_of_instructions, const char *log_path);
+
+/**
+ * Traces the instruction at index, before it executes
+ */
+void trace_inst(uint32_t index);
+
+/**
+ * Traces that the conditional branch traced last was taken
+ */
+void trace_taken();
+
+/**
+ * Flushes and closes the binary log, if there is one
+ */
+void trace_stop();
+
+#define TRACE_MAGIC "RVTRACE1"
+#define TRACE_TAKEN 0x80000000u // set in the record of a taken branch
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+/**
+ * Prints a binary trace log written with -trace-log as the text trace the
+ * interpreter would have printed to stdout
+ */
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <trace log>\n", argv[0]);
+        return 1;
+    }
+    FILE *log_file = fopen(argv[1], "rb");
+    if (log_file == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    uint32_t n;
+    if (fread(magic, 1, sizeof(magic), log_file) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&n, sizeof(n), 1, log_file) != 1)
+    {
+        fprintf(stderr, "%s is not a trace log\n", argv[1]);
+        fclose(log_file);
+        return 1;
+    }
+
+    // the trace line of every instruction, "" for those without one
+    char **lines = calloc(n > 0 ? n : 1, sizeof(char *));
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint16_t len = 0;
+        if (fread(&len, sizeof(len), 1, log_file) != 1)
+        {
+            len = 0;
+        }
+        lines[i] = calloc(len + 1, 1);
+        if (fread(lines[i], 1, len, log_file) != len)
+        {
+            lines[i][0] = '\0';
+        }
+    }
+
+    uint32_t records[4096];
+    size_t n_records;
+    int status = 0;
+    while ((n_records = fread(records, sizeof(uint32_t), 4096, log_file)) > 0)
+    {
+        for (size_t r = 0; r < n_records; r++)
+        {
+            uint32_t index = records[r] & ~TRACE_TAKEN;
+            if (index >= n)
+            {
+                fprintf(stderr, "Record for instruction %u outside the program\n", index);
+                status = 1;
+                continue;
+            }
+            if (lines[index][0])
+            {
+                puts(lines[index]);
+            }
+            if (records[r] & TRACE_TAKEN)
+            {
+                printf("branch\n");
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        free(lines[i]);
+    }
+    free(lines);
+    fclose(log_file);
+    return status;
+}